@@ -41,6 +41,24 @@ the pcWriteBuffer buffer, and pcCommandString is the entire string as input by
 the user (from which parameters can be extracted).*/
 typedef BaseType_t (*pdCOMMAND_LINE_CALLBACK)( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString );
 
+/* The maximum number of words, including the command itself, passed to an
+argument vector callback.  Further words are counted but not passed. */
+#ifndef configCOMMAND_INT_MAX_ARGS
+	#define configCOMMAND_INT_MAX_ARGS 16
+#endif
+
+/* One space delimited word of the command string, it is not null terminated. */
+typedef struct xCOMMAND_LINE_ARGUMENT
+{
+	const char *pcArgument;
+	BaseType_t xArgumentLength;
+} CLI_Argument_t;
+
+/* The prototype of the argument vector callback functions.  The command string
+is split into words only once, pxArgv[ 0 ] is the command itself and
+pxArgv[ 1 ] to pxArgv[ xArgc - 1 ] are the parameters. */
+typedef BaseType_t (*pdCOMMAND_LINE_ARGV_CALLBACK)( char *pcWriteBuffer, size_t xWriteBufferLen, BaseType_t xArgc, const CLI_Argument_t *pxArgv );
+
 /* The structure that defines command line commands.  A command line command
 should be defined by declaring a const structure of this type. */
 typedef struct xCOMMAND_LINE_INPUT
@@ -49,6 +67,7 @@ typedef struct xCOMMAND_LINE_INPUT
 	const char * const pcHelpString;			/* String that describes how to use the command.  Should start with the command itself, and end with "\r\n".  For example "help: Returns a list of all the commands\r\n". */
 	const pdCOMMAND_LINE_CALLBACK pxCommandInterpreter;	/* A pointer to the callback function that will return the output generated by the command. */
 	int8_t cExpectedNumberOfParameters;			/* Commands expect a fixed number of parameters, which may be zero. */
+	const pdCOMMAND_LINE_ARGV_CALLBACK pxArgvCommandInterpreter;	/* Used instead of pxCommandInterpreter when that is NULL. */
 } CLI_Command_Definition_t;
 
 /* For backward compatibility. */
@@ -58,7 +77,9 @@ typedef struct xCOMMAND_LINE_INPUT
  * Register the command passed in using the pxCommandToRegister parameter.
  * Registering a command adds the command to the list of commands that are
  * handled by the command interpreter.  Once a command has been registered it
- * can be executed from the command line.
+ * can be executed from the command line.  No memory is allocated, at most
+ * configCOMMAND_INT_MAX_COMMANDS commands can be registered, pdFAIL is returned
+ * above that.
  */
 BaseType_t FreeRTOS_CLIRegisterCommand( const CLI_Command_Definition_t * const pxCommandToRegister );
 
@@ -77,19 +98,6 @@ BaseType_t FreeRTOS_CLIProcessCommand( const char * const pcCommandInput, char *
 
 /*-----------------------------------------------------------*/
 
-/*
- * A buffer into which command outputs can be written is declared in the
- * main command interpreter, rather than in the command console implementation,
- * to allow application that provide access to the command console via multiple
- * interfaces to share a buffer, and therefore save RAM.  Note, however, that
- * the command interpreter itself is not re-entrant, so only one command
- * console interface can be used at any one time.  For that reason, no attempt
- * is made to provide any mutual exclusion mechanism on the output buffer.
- *
- * FreeRTOS_CLIGetOutputBuffer() returns the address of the output buffer.
- */
-char *FreeRTOS_CLIGetOutputBuffer( void );
-
 /*
  * Return a pointer to the xParameterNumber'th word in pcCommandString.
  */
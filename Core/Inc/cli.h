@@ -12,7 +12,7 @@ typedef BaseType_t ( *cli_callback_t )( const char * const cli_input, char * cli
  * Create the task that implements a command console using the USB virtual com
  * port driver for input and output.
  */
-void cli_init( char *cli_output_buffer, cli_callback_t cli_callback );
+void cli_init( cli_callback_t cli_callback );
 
 #endif /* CLI_IO_H */
 
@@ -0,0 +1,42 @@
+/*
+ * cpu_load.h
+ *
+ *  Created on: 2026. okt. 17.
+ *      Author: Balint
+ */
+
+#ifndef INC_CPU_LOAD_H_
+#define INC_CPU_LOAD_H_
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+/* Maximum number of tasks tracked, tasks above this are not sampled */
+#ifndef CPU_LOAD_MAX_TASKS
+	#define CPU_LOAD_MAX_TASKS						16
+#endif
+
+/* The run time of each task is sampled once per CPU_LOAD_SAMPLE_PERIOD_MS,
+the last CPU_LOAD_SAMPLE_COUNT samples are kept */
+#define CPU_LOAD_SAMPLE_PERIOD_MS					1000U
+#define CPU_LOAD_SAMPLE_COUNT						60U
+
+typedef enum {
+	CPU_LOAD_WINDOW_1S = 0,
+	CPU_LOAD_WINDOW_10S,
+	CPU_LOAD_WINDOW_60S,
+	CPU_LOAD_WINDOW_COUNT
+} cpu_load_window_t;
+
+typedef struct {
+	char        name[configMAX_TASK_NAME_LEN];
+	UBaseType_t task_number;
+	uint16_t    permille[CPU_LOAD_WINDOW_COUNT];	/* CPU load in 0.1 % units */
+} cpu_load_task_t;
+
+void     cpu_load_init(void);
+void     cpu_load_deinit(void);
+uint32_t cpu_load_get(cpu_load_task_t *tasks, uint32_t max_tasks);
+
+#endif /* INC_CPU_LOAD_H_ */
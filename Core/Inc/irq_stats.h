@@ -0,0 +1,83 @@
+/*
+ * irq_stats.h
+ *
+ *  Created on: 2026. okt. 17.
+ *      Author: Balint
+ */
+
+#ifndef INC_IRQ_STATS_H_
+#define INC_IRQ_STATS_H_
+
+#include <stdint.h>
+
+#include "stm32f4xx.h"
+
+/* When set to 1 the interrupt handlers in stm32f4xx_it.c measure their
+execution time with the DWT cycle counter, see the irq-stats command. */
+#ifndef IRQ_STATS
+	#define IRQ_STATS								1
+#endif
+
+typedef enum {
+	IRQ_STATS_OTG_FS = 0,
+	IRQ_STATS_USART2,
+	IRQ_STATS_DMA1_STREAM5,
+	IRQ_STATS_DMA1_STREAM6,
+	IRQ_STATS_TIM7,
+	IRQ_STATS_COUNT
+} irq_stats_id_t;
+
+typedef struct {
+	uint32_t count;
+	uint32_t max_cycles;
+	uint64_t total_cycles;
+} irq_stats_t;
+
+extern irq_stats_t irq_stats[IRQ_STATS_COUNT];
+extern uint32_t    irq_stats_nested_cycles;
+
+void        irq_stats_init(void);
+void        irq_stats_reset(void);
+void        irq_stats_get(irq_stats_id_t id, irq_stats_t *stats);
+uint64_t    irq_stats_get_elapsed_cycles(void);
+const char *irq_stats_name(irq_stats_id_t id);
+
+/**
+  * @brief  Accounts the execution of an interrupt handler
+  * @param  id of the interrupt
+  * @param  start DWT cycle counter at the entry of the handler
+  * @param  nested irq_stats_nested_cycles at the entry of the handler
+  * @retval None
+  * @note	The time spent in nested (higher priority) interrupts is not
+  * 		charged to the preempted one, so the totals add up to the time
+  * 		spent in interrupts. Use IRQ_STATS_ENTER and IRQ_STATS_EXIT.
+  */
+static inline void irq_stats_exit_(irq_stats_id_t id, uint32_t start, uint32_t nested)
+{
+	const uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	const uint32_t elapsed = DWT->CYCCNT - start;
+	const uint32_t cycles  = elapsed - (irq_stats_nested_cycles - nested);
+	irq_stats_nested_cycles = nested + elapsed;
+
+	irq_stats_t *stats = &irq_stats[id];
+	stats->count        = stats->count + 1U;
+	stats->total_cycles = stats->total_cycles + cycles;
+	if (cycles > stats->max_cycles) {
+		stats->max_cycles = cycles;
+	}
+
+	__set_PRIMASK(primask);
+}
+
+#if (1 == IRQ_STATS)
+	#define IRQ_STATS_ENTER()		const uint32_t irq_stats_start_  = DWT->CYCCNT; \
+									const uint32_t irq_stats_nested_ = irq_stats_nested_cycles
+	#define IRQ_STATS_EXIT(id)		irq_stats_exit_((id), irq_stats_start_, irq_stats_nested_)
+#else
+	#define IRQ_STATS_ENTER()
+	#define IRQ_STATS_EXIT(id)
+#endif
+
+#endif /* INC_IRQ_STATS_H_ */
@@ -9,12 +9,111 @@
 #define INC_LOG_H_
 
 #include <stdarg.h>
+#include <stdint.h>
 
-void log_init(void);
-void log_deinit(void);
-int  log_info(const char * s, ...);
-int  log_warning(const char * s, ...);
-int  log_error(const char * s, ...);
+/* Log calls below this level are compiled out together with their format
+strings and arguments: 0 debug, 1 info, 2 warning, 3 error, 4 none */
+#ifndef LOG_COMPILE_LEVEL
+	#define LOG_COMPILE_LEVEL						0
+#endif
+
+/* Module of the log calls in a source file. Define it before the includes of
+the file to filter its messages separately, see log_set_level. */
+#ifndef LOG_MODULE
+	#define LOG_MODULE								LOG_MODULE_DEFAULT
+#endif
+
+/* The values must match LOG_COMPILE_LEVEL */
+typedef enum {
+	LOG_LEVEL_DEBUG = 0,
+	LOG_LEVEL_INFO = 1,
+	LOG_LEVEL_WARNING = 2,
+	LOG_LEVEL_ERROR = 3,
+	LOG_LEVEL_COUNT
+} log_level_t;
+
+/* Threshold that disables every level of a module */
+#define LOG_LEVEL_OFF								LOG_LEVEL_COUNT
+
+typedef enum {
+	LOG_MODULE_DEFAULT = 0,
+	LOG_MODULE_MAIN,
+	LOG_MODULE_CLI,
+	LOG_MODULE_COUNT
+} log_module_t;
+
+/**
+  * @brief  What a log call does when the log buffer is full
+  * @note	LOG_POLICY_BLOCK waits for free space forever, LOG_POLICY_TIMEOUT
+  * 		at most for the given time, LOG_POLICY_DROP_NEWEST drops the
+  * 		message right away. LOG_POLICY_OVERWRITE_OLDEST discards the
+  * 		oldest messages that are not being transmitted yet and waits at
+  * 		most for the given time for the space they occupy.
+  */
+typedef enum {
+	LOG_POLICY_BLOCK = 0,
+	LOG_POLICY_TIMEOUT,
+	LOG_POLICY_DROP_NEWEST,
+	LOG_POLICY_OVERWRITE_OLDEST
+} log_policy_t;
+
+/* Runtime threshold of each module, use log_set_level to change it */
+extern volatile uint8_t log_module_levels[LOG_MODULE_COUNT];
+
+void         log_init(void);
+void         log_deinit(void);
+void         log_set_policy(log_level_t level, log_policy_t policy, uint32_t timeout_ms);
+void         log_set_level(log_module_t module, log_level_t level);
+log_level_t  log_get_level(log_module_t module);
+const char * log_module_name(log_module_t module);
+int          log_level_(log_level_t level, const char * s, ...);
+int          log_with_policy_(log_level_t level, log_policy_t policy, uint32_t timeout_ms, const char * s, ...);
+int          log_level_from_isr_(log_level_t level, const char * s, ...);
+
+static inline int log_disabled_(void)
+{
+	return 0;
+}
+
+/* The runtime threshold is checked before the arguments are evaluated, so a
+disabled call costs a load and a compare. A call below LOG_COMPILE_LEVEL costs
+nothing, the level of log_with_policy must be a constant for that. */
+#define LOG_IS_ENABLED(module, level)			((level) >= log_module_levels[(module)])
+
+#define log_with_policy(level, policy, timeout_ms, ...) \
+	((((int)(level) >= LOG_COMPILE_LEVEL) && LOG_IS_ENABLED(LOG_MODULE, (level))) ? log_with_policy_((level), (policy), (timeout_ms), __VA_ARGS__) : 0)
+
+#if (LOG_COMPILE_LEVEL <= 0)
+	#define log_debug(...)						(LOG_IS_ENABLED(LOG_MODULE, LOG_LEVEL_DEBUG) ? log_level_(LOG_LEVEL_DEBUG, __VA_ARGS__) : 0)
+	#define log_debug_from_isr(...)				(LOG_IS_ENABLED(LOG_MODULE, LOG_LEVEL_DEBUG) ? log_level_from_isr_(LOG_LEVEL_DEBUG, __VA_ARGS__) : 0)
+#else
+	#define log_debug(...)						log_disabled_()
+	#define log_debug_from_isr(...)				log_disabled_()
+#endif
+
+#if (LOG_COMPILE_LEVEL <= 1)
+	#define log_info(...)						(LOG_IS_ENABLED(LOG_MODULE, LOG_LEVEL_INFO) ? log_level_(LOG_LEVEL_INFO, __VA_ARGS__) : 0)
+	#define log_info_from_isr(...)				(LOG_IS_ENABLED(LOG_MODULE, LOG_LEVEL_INFO) ? log_level_from_isr_(LOG_LEVEL_INFO, __VA_ARGS__) : 0)
+#else
+	#define log_info(...)						log_disabled_()
+	#define log_info_from_isr(...)				log_disabled_()
+#endif
+
+#if (LOG_COMPILE_LEVEL <= 2)
+	#define log_warning(...)					(LOG_IS_ENABLED(LOG_MODULE, LOG_LEVEL_WARNING) ? log_level_(LOG_LEVEL_WARNING, __VA_ARGS__) : 0)
+	#define log_warning_from_isr(...)			(LOG_IS_ENABLED(LOG_MODULE, LOG_LEVEL_WARNING) ? log_level_from_isr_(LOG_LEVEL_WARNING, __VA_ARGS__) : 0)
+#else
+	#define log_warning(...)					log_disabled_()
+	#define log_warning_from_isr(...)			log_disabled_()
+#endif
+
+#if (LOG_COMPILE_LEVEL <= 3)
+	#define log_error(...)						(LOG_IS_ENABLED(LOG_MODULE, LOG_LEVEL_ERROR) ? log_level_(LOG_LEVEL_ERROR, __VA_ARGS__) : 0)
+	#define log_error_from_isr(...)				(LOG_IS_ENABLED(LOG_MODULE, LOG_LEVEL_ERROR) ? log_level_from_isr_(LOG_LEVEL_ERROR, __VA_ARGS__) : 0)
+#else
+	#define log_error(...)						log_disabled_()
+	#define log_error_from_isr(...)				log_disabled_()
+#endif
 
 #endif /* INC_LOG_H_ */
 
@@ -11,12 +11,61 @@
 #include <stdint.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
+
+#include "FreeRTOS.h"
+
+#include "log.h"
+
+typedef struct {
+	uint32_t dma_transfers;
+	uint32_t messages;
+	uint32_t bytes;
+	uint32_t max_batch_messages;
+	uint32_t max_batch_bytes;
+} uart_tx_stats_t;
+
+typedef struct {
+	uint32_t events;
+	uint32_t bytes;
+	uint32_t dropped_bytes;
+	uint32_t errors;
+} uart_rx_stats_t;
+
+/* Errors are sent on the urgent lane, everything else on the bulk lane */
+typedef enum {
+	UART_TX_LANE_URGENT = 0,
+	UART_TX_LANE_BULK,
+	UART_TX_LANE_COUNT
+} uart_tx_lane_t;
+
+/* Bucket 0 counts the messages transmitted within 1 ms after their commit,
+bucket i the ones within [2^(i-1), 2^i) ms, the last one the rest */
+#define UART_TX_LATENCY_BUCKETS						12
+
+typedef struct {
+	uint32_t buckets[UART_TX_LATENCY_BUCKETS];
+	uint32_t max_ms;
+} uart_tx_latency_t;
+
+typedef struct {
+	uint32_t dropped[LOG_LEVEL_COUNT];
+	uint32_t overwritten;
+} log_drop_stats_t;
 
 void log_and_cli_io_init(void);
 void log_and_cli_io_deinit(void);
-int  log_(const char * format, const char * type, va_list va);
+int  log_(const char * format, log_level_t level, log_policy_t policy, uint32_t timeout_ms, va_list va);
+int  log_from_isr_(const char * format, log_level_t level, va_list va);
 uint32_t cli_io_read(uint8_t *ch);
+size_t   cli_io_read_bulk(uint8_t *buf, size_t max, TickType_t ticks_to_wait);
 void cli_io_write(const char * s, uint16_t size);
+char *cli_io_reserve(uint16_t size, uint16_t *handle);
+void cli_io_commit(uint16_t handle, uint16_t size);
+void log_and_cli_io_get_tx_stats(uart_tx_stats_t *stats);
+void log_and_cli_io_get_rx_stats(uart_rx_stats_t *stats);
+void log_and_cli_io_get_drop_stats(log_drop_stats_t *stats);
+void log_and_cli_io_get_tx_latency(uart_tx_lane_t lane, uart_tx_latency_t *latency);
 
 
 #endif /* INC_LOG_AND_CLI_IO_H_ */
@@ -0,0 +1,52 @@
+/*
+ * log_record.h
+ *
+ *  Created on: 2026. okt. 17.
+ *      Author: Balint
+ */
+
+#ifndef INC_LOG_RECORD_H_
+#define INC_LOG_RECORD_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+
+/* Maximum number of 32-bit argument words captured per message.
+Doubles and long longs take two words, '*' width and precision one each. */
+#ifndef LOG_RECORD_MAX_ARGS
+	#define LOG_RECORD_MAX_ARGS						16
+#endif
+
+/**
+  * @brief  Deferred log message as stored in the log record buffer
+  * @note	format and type must point to storage that outlives the record
+  * 		(string literals), the same applies to the %s arguments since
+  * 		only their address is captured.
+  */
+typedef struct {
+	uint32_t    timestamp;		/* microsecond counter, see timestamp_get */
+	const char *format;
+	const char *type;
+	uint32_t    arg_count;
+	uint32_t    args[];
+} log_record_t;
+
+#define LOG_RECORD_SIZE(arg_count)					(sizeof(log_record_t) + ((arg_count) * sizeof(uint32_t)))
+
+/* Binary wire format. A frame is 0x00, the COBS encoded payload and 0x00, so
+it can be told apart from the CLI text on the same line. The payload is a
+sequence of unsigned LEB128 varints:
+ - log frame:  format - LOG_RECORD_ADDRESS_BASE, type - LOG_RECORD_ADDRESS_BASE,
+               zigzag microsecond delta to the previous frame, argument words
+ - sync frame: 0, seconds of the day, microsecond timestamp of its start */
+#define LOG_RECORD_ADDRESS_BASE						0x08000000UL
+#define LOG_RECORD_PAYLOAD_MAX_SIZE					((3 + LOG_RECORD_MAX_ARGS) * 5)
+#define LOG_RECORD_FRAME_MAX_SIZE					(LOG_RECORD_PAYLOAD_MAX_SIZE + (LOG_RECORD_PAYLOAD_MAX_SIZE / 254) + 3)
+
+uint32_t log_record_capture(const char *format, va_list va, uint32_t *args, uint32_t max_args);
+int      log_record_format(char *buffer, size_t size, const char *format, const uint32_t *args, uint32_t arg_count);
+size_t   log_record_encode(uint8_t *frame, const log_record_t *record, int32_t timestamp_delta);
+size_t   log_record_encode_sync(uint8_t *frame, uint32_t seconds_of_day, uint32_t timestamp);
+
+#endif /* INC_LOG_RECORD_H_ */
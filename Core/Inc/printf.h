@@ -109,6 +109,14 @@ int vprintf_(const char* format, va_list va);
 int fctprintf(void (*out)(char character, void* arg), void* arg, const char* format, ...);
 
 
+/**
+ * Statistics of the format program cache, see PRINTF_FORMAT_CACHE_SIZE
+ * \param hits Number of calls that ran a cached program instead of parsing the format
+ * \param misses Number of calls with a cacheable format that was not in the cache
+ */
+void printf_format_cache_stats(unsigned long* hits, unsigned long* misses);
+
+
 #ifdef __cplusplus
 }
 #endif
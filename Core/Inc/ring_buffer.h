@@ -0,0 +1,48 @@
+/*
+ * ring_buffer.h
+ *
+ *  Created on: 2026. okt. 17.
+ *      Author: Balint
+ */
+
+#ifndef INC_RING_BUFFER_H_
+#define INC_RING_BUFFER_H_
+
+#include <stdint.h>
+
+/**
+  * @brief  Describes one variable-length record stored in the ring buffer
+  * @note	pos is a free-running byte position, the physical offset is
+  * 		pos & (buffer_size - 1)
+  */
+typedef struct {
+	uint16_t pos;
+	uint16_t size;
+	volatile uint32_t committed;
+} ring_buffer_desc_t;
+
+/**
+  * @brief  Byte-granular multi producer, single consumer ring buffer
+  * @note	head packs the descriptor head (upper 16 bits) and the data head
+  * 		(lower 16 bits) so a single LDREX/STREX reserves both.
+  * 		buffer_size and desc_count must be powers of two not larger than 32768.
+  */
+typedef struct {
+	uint8_t            *buffer;
+	uint32_t            buffer_size;
+	ring_buffer_desc_t *desc;
+	uint32_t            desc_count;
+	volatile uint32_t   head;
+	volatile uint16_t   data_tail;
+	volatile uint16_t   desc_tail;
+	volatile uint16_t   desc_read;
+} ring_buffer_t;
+
+void     ring_buffer_init(ring_buffer_t *rb, uint8_t *buffer, uint32_t buffer_size, ring_buffer_desc_t *desc, uint32_t desc_count);
+uint8_t *ring_buffer_reserve(ring_buffer_t *rb, uint16_t size, uint16_t *handle);
+void     ring_buffer_commit(ring_buffer_t *rb, uint16_t handle, uint16_t size);
+uint8_t *ring_buffer_read(ring_buffer_t *rb, uint16_t max_size, uint16_t *size, uint16_t *count);
+void     ring_buffer_release(ring_buffer_t *rb, uint16_t desc_end);
+uint16_t ring_buffer_skip(ring_buffer_t *rb, uint16_t size);
+
+#endif /* INC_RING_BUFFER_H_ */
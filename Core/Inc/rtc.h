@@ -20,6 +20,7 @@ extern "C" {
 void RTC_Init(void);
 void RTC_Deinit(void);
 void RTC_GetTime(uint8_t *hours, uint8_t *minutes, uint8_t *seconds);
+void RTC_GetTimeOfDay(uint32_t *seconds, uint32_t *microseconds);
 void RTC_SetTime(uint8_t hours, uint8_t minutes, uint8_t seconds);
 void RTC_GetDate(uint8_t *day, uint8_t *month, uint8_t *year);
 void RTC_SetDate(uint8_t day, uint8_t month, uint8_t year);
@@ -0,0 +1,35 @@
+/*
+ * timestamp.h
+ *
+ *  Created on: 2026. okt. 17.
+ *      Author: Balint
+ */
+
+#ifndef INC_TIMESTAMP_H_
+#define INC_TIMESTAMP_H_
+
+#include <stdint.h>
+
+#include "stm32f4xx.h"
+
+/* Free-running 32-bit microsecond counter, wraps around in ~71.5 minutes */
+#define TIMESTAMP_TIMER								TIM5
+
+void timestamp_init(void);
+void timestamp_deinit(void);
+void timestamp_sync(void);
+void timestamp_to_time_of_day(uint32_t timestamp, uint32_t *seconds, uint32_t *microseconds);
+
+/**
+  * @brief  Gets the current timestamp
+  * @param  None
+  * @retval value of the free-running microsecond counter
+  * @note	This function can be called from any context, the counter is
+  * 		converted to wall-clock time with timestamp_to_time_of_day.
+  */
+static inline uint32_t timestamp_get(void)
+{
+	return TIMESTAMP_TIMER->CNT;
+}
+
+#endif /* INC_TIMESTAMP_H_ */
@@ -36,20 +36,29 @@
 /* Utils includes. */
 #include "FreeRTOS_CLI.h"
 
-/* If the application writer needs to place the buffer used by the CLI at a
-fixed address then set configAPPLICATION_PROVIDES_cOutputBuffer to 1 in
-FreeRTOSConfig.h, then declare an array with the following name and size in 
-one of the application files:
-	char cOutputBuffer[ configCOMMAND_INT_MAX_OUTPUT_SIZE ];
-*/
-#ifndef configAPPLICATION_PROVIDES_cOutputBuffer
-	#define configAPPLICATION_PROVIDES_cOutputBuffer 0
+/* The maximum number of commands that can be registered, including the help
+command.  The registered commands are held in a static table, no memory is
+allocated when a command is registered. */
+#ifndef configCOMMAND_INT_MAX_COMMANDS
+	#define configCOMMAND_INT_MAX_COMMANDS 32
+#endif
+
+/* The commands are looked up through an open addressing hash table that is
+at least twice the size of the command table, so the probe sequences stay
+short.  Must be a power of 2. */
+#define cliHASH_TABLE_SIZE		( 2U * cliNEXT_POWER_OF_2( configCOMMAND_INT_MAX_COMMANDS ) )
+#define cliNEXT_POWER_OF_2( x )	( ( ( x ) <= 16U ) ? 16U : ( ( x ) <= 32U ) ? 32U : ( ( x ) <= 64U ) ? 64U : ( ( x ) <= 128U ) ? 128U : ( ( x ) <= 256U ) ? 256U : 512U )
+#define cliHASH_SLOT_EMPTY		( 0xFFFFU )
+
+#if( configCOMMAND_INT_MAX_COMMANDS > 512 )
+	#error "configCOMMAND_INT_MAX_COMMANDS must not exceed 512"
 #endif
 
 typedef struct xCOMMAND_INPUT_LIST
 {
 	const CLI_Command_Definition_t *pxCommandLineDefinition;
-	struct xCOMMAND_INPUT_LIST *pxNext;
+	uint32_t ulHash;				/* Hash of the command string. */
+	size_t xCommandStringLength;	/* Length of the command string. */
 } CLI_Definition_List_Item_t;
 
 /*
@@ -59,9 +68,28 @@ typedef struct xCOMMAND_INPUT_LIST
 static BaseType_t prvHelpCommand( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString );
 
 /*
- * Return the number of parameters that follow the command name.
+ * Split the command string into space delimited words in a single pass.  Up
+ * to xMaxArguments words are stored in pxArgv, the total number of words is
+ * returned.
  */
-static int8_t prvGetNumberOfParameters( const char *pcCommandString );
+static BaseType_t prvTokenizeCommand( const char *pcCommandString, CLI_Argument_t *pxArgv, BaseType_t xMaxArguments );
+
+/*
+ * Hash the first xLength characters of pcString.
+ */
+static uint32_t prvHashCommand( const char *pcString, size_t xLength );
+
+/*
+ * Find a registered command by its name, returns NULL if it is not registered.
+ */
+static const CLI_Definition_List_Item_t *prvFindCommand( const char *pcCommandName, size_t xCommandStringLength );
+
+/*
+ * Add a command to the command table and the hash table, returns pdFAIL if the
+ * command table is full.  The help command is added first on the first call.
+ * Must be called from a critical section.
+ */
+static BaseType_t prvAddCommand( const CLI_Command_Definition_t * const pxCommandToRegister );
 
 /* The definition of the "help" command.  This command is always at the front
 of the list of registered commands. */
@@ -73,71 +101,33 @@ static const CLI_Command_Definition_t xHelpCommand =
 	0
 };
 
-/* The definition of the list of commands.  Commands that are registered are
-added to this list. */
-static CLI_Definition_List_Item_t xRegisteredCommands =
-{
-	&xHelpCommand,	/* The first command in the list is always the help command, defined in this file. */
-	NULL			/* The next pointer is initialised to NULL, as there are no other registered commands yet. */
-};
+/* The table of commands in the order of registration, this is the order the
+help command lists them in.  The first command is always the help command,
+it is added on the first registration. */
+static CLI_Definition_List_Item_t xRegisteredCommands[ configCOMMAND_INT_MAX_COMMANDS ];
+static UBaseType_t uxRegisteredCommandCount = 0;
 
-/* A buffer into which command outputs can be written is declared here, rather
-than in the command console implementation, to allow multiple command consoles
-to share the same buffer.  For example, an application may allow access to the
-command interpreter by UART and by Ethernet.  Sharing a buffer is done purely
-to save RAM.  Note, however, that the command console itself is not re-entrant,
-so only one command interpreter interface can be used at any one time.  For that
-reason, no attempt at providing mutual exclusion to the cOutputBuffer array is
-attempted.
-
-configAPPLICATION_PROVIDES_cOutputBuffer is provided to allow the application
-writer to provide their own cOutputBuffer declaration in cases where the
-buffer needs to be placed at a fixed address (rather than by the linker). */
-#if( configAPPLICATION_PROVIDES_cOutputBuffer == 0 )
-	static char cOutputBuffer[ configCOMMAND_INT_MAX_OUTPUT_SIZE ];
-#else
-	extern char cOutputBuffer[ configCOMMAND_INT_MAX_OUTPUT_SIZE ];
-#endif
+/* Indexes into xRegisteredCommands, cliHASH_SLOT_EMPTY marks an empty slot. */
+static uint16_t usCommandHashTable[ cliHASH_TABLE_SIZE ];
 
 
 /*-----------------------------------------------------------*/
 
 BaseType_t FreeRTOS_CLIRegisterCommand( const CLI_Command_Definition_t * const pxCommandToRegister )
 {
-static CLI_Definition_List_Item_t *pxLastCommandInList = &xRegisteredCommands;
-CLI_Definition_List_Item_t *pxNewListItem;
-BaseType_t xReturn = pdFAIL;
+BaseType_t xReturn;
 
 	/* Check the parameter is not NULL. */
 	configASSERT( pxCommandToRegister );
 
-	/* Create a new list item that will reference the command being registered. */
-	pxNewListItem = ( CLI_Definition_List_Item_t * ) pvPortMalloc( sizeof( CLI_Definition_List_Item_t ) );
-	configASSERT( pxNewListItem );
-
-	if( pxNewListItem != NULL )
+	taskENTER_CRITICAL();
 	{
-		taskENTER_CRITICAL();
-		{
-			/* Reference the command being registered from the newly created
-			list item. */
-			pxNewListItem->pxCommandLineDefinition = pxCommandToRegister;
-
-			/* The new list item will get added to the end of the list, so
-			pxNext has nowhere to point. */
-			pxNewListItem->pxNext = NULL;
-
-			/* Add the newly created list item to the end of the already existing
-			list. */
-			pxLastCommandInList->pxNext = pxNewListItem;
-
-			/* Set the end of list marker to the new list item. */
-			pxLastCommandInList = pxNewListItem;
-		}
-		taskEXIT_CRITICAL();
-
-		xReturn = pdPASS;
+		xReturn = prvAddCommand( pxCommandToRegister );
 	}
+	taskEXIT_CRITICAL();
+
+	/* Increase configCOMMAND_INT_MAX_COMMANDS if this fails. */
+	configASSERT( xReturn == pdPASS );
 
 	return xReturn;
 }
@@ -146,42 +136,38 @@ BaseType_t xReturn = pdFAIL;
 BaseType_t FreeRTOS_CLIProcessCommand( const char * const pcCommandInput, char * pcWriteBuffer, size_t xWriteBufferLen  )
 {
 static const CLI_Definition_List_Item_t *pxCommand = NULL;
+static CLI_Argument_t xArgv[ configCOMMAND_INT_MAX_ARGS ];
+static BaseType_t xArgc = 0;
 BaseType_t xReturn = pdTRUE;
-const char *pcRegisteredCommandString;
-size_t xCommandStringLength;
+BaseType_t xWordCount;
 
 	/* Note:  This function is not re-entrant.  It must not be called from more
 	thank one task. */
 
 	if( pxCommand == NULL )
 	{
-		/* Search for the command string in the list of registered commands. */
-		for( pxCommand = &xRegisteredCommands; pxCommand != NULL; pxCommand = pxCommand->pxNext )
+		/* Split the command string into words once, the words are kept for the
+		following calls of a command that returns more than one string. */
+		xWordCount = prvTokenizeCommand( pcCommandInput, xArgv, configCOMMAND_INT_MAX_ARGS );
+		xArgc = ( xWordCount < configCOMMAND_INT_MAX_ARGS ) ? xWordCount : configCOMMAND_INT_MAX_ARGS;
+
+		/* Look up the command string in the hash table of registered commands. */
+		if( xArgc > 0 )
+		{
+			pxCommand = prvFindCommand( xArgv[ 0 ].pcArgument, ( size_t ) xArgv[ 0 ].xArgumentLength );
+		}
+
+		if( pxCommand != NULL )
 		{
-			pcRegisteredCommandString = pxCommand->pxCommandLineDefinition->pcCommand;
-			xCommandStringLength = strlen( pcRegisteredCommandString );
-
-			/* To ensure the string lengths match exactly, so as not to pick up
-			a sub-string of a longer command, check the byte after the expected
-			end of the string is either the end of the string or a space before
-			a parameter. */
-			if( strncmp( pcCommandInput, pcRegisteredCommandString, xCommandStringLength ) == 0 )
+			/* The command has been found.  Check it has the expected
+			number of parameters.  If cExpectedNumberOfParameters is -1,
+			then there could be a variable number of parameters and no
+			check is made. */
+			if( pxCommand->pxCommandLineDefinition->cExpectedNumberOfParameters >= 0 )
 			{
-				if( ( pcCommandInput[ xCommandStringLength ] == ' ' ) || ( pcCommandInput[ xCommandStringLength ] == 0x00 ) )
+				if( ( xWordCount - 1 ) != pxCommand->pxCommandLineDefinition->cExpectedNumberOfParameters )
 				{
-					/* The command has been found.  Check it has the expected
-					number of parameters.  If cExpectedNumberOfParameters is -1,
-					then there could be a variable number of parameters and no
-					check is made. */
-					if( pxCommand->pxCommandLineDefinition->cExpectedNumberOfParameters >= 0 )
-					{
-						if( prvGetNumberOfParameters( pcCommandInput ) != pxCommand->pxCommandLineDefinition->cExpectedNumberOfParameters )
-						{
-							xReturn = pdFALSE;
-						}
-					}
-
-					break;
+					xReturn = pdFALSE;
 				}
 			}
 		}
@@ -197,7 +183,15 @@ size_t xCommandStringLength;
 	else if( pxCommand != NULL )
 	{
 		/* Call the callback function that is registered to this command. */
-		xReturn = pxCommand->pxCommandLineDefinition->pxCommandInterpreter( pcWriteBuffer, xWriteBufferLen, pcCommandInput );
+		if( pxCommand->pxCommandLineDefinition->pxCommandInterpreter != NULL )
+		{
+			xReturn = pxCommand->pxCommandLineDefinition->pxCommandInterpreter( pcWriteBuffer, xWriteBufferLen, pcCommandInput );
+		}
+		else
+		{
+			configASSERT( pxCommand->pxCommandLineDefinition->pxArgvCommandInterpreter );
+			xReturn = pxCommand->pxCommandLineDefinition->pxArgvCommandInterpreter( pcWriteBuffer, xWriteBufferLen, xArgc, xArgv );
+		}
 
 		/* If xReturn is pdFALSE, then no further strings will be returned
 		after this one, and	pxCommand can be reset to NULL ready to search
@@ -218,12 +212,6 @@ size_t xCommandStringLength;
 }
 /*-----------------------------------------------------------*/
 
-char *FreeRTOS_CLIGetOutputBuffer( void )
-{
-	return cOutputBuffer;
-}
-/*-----------------------------------------------------------*/
-
 const char *FreeRTOS_CLIGetParameter( const char *pcCommandString, UBaseType_t uxWantedParameter, BaseType_t *pxParameterStringLength )
 {
 UBaseType_t uxParametersFound = 0;
@@ -282,24 +270,21 @@ const char *pcReturn = NULL;
 
 static BaseType_t prvHelpCommand( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString )
 {
-static const CLI_Definition_List_Item_t * pxCommand = NULL;
+static UBaseType_t uxCommand = 0;
 BaseType_t xReturn;
 
 	( void ) pcCommandString;
 
-	if( pxCommand == NULL )
-	{
-		/* Reset the pxCommand pointer back to the start of the list. */
-		pxCommand = &xRegisteredCommands;
-	}
-
-	/* Return the next command help string, before moving the pointer on to
-	the next command in the list. */
-	strncpy( pcWriteBuffer, pxCommand->pxCommandLineDefinition->pcHelpString, xWriteBufferLen );
-	pxCommand = pxCommand->pxNext;
+	/* Return the next command help string, before moving the index on to
+	the next command in the table. */
+	strncpy( pcWriteBuffer, xRegisteredCommands[ uxCommand ].pxCommandLineDefinition->pcHelpString, xWriteBufferLen );
+	uxCommand++;
 
-	if( pxCommand == NULL )
+	if( uxCommand >= uxRegisteredCommandCount )
 	{
+		/* Reset the index back to the start of the table. */
+		uxCommand = 0;
+
 		/* There are no more commands in the list, so there will be no more
 		strings to return after this one and pdFALSE should be returned. */
 		xReturn = pdFALSE;
@@ -313,39 +298,130 @@ BaseType_t xReturn;
 }
 /*-----------------------------------------------------------*/
 
-static int8_t prvGetNumberOfParameters( const char *pcCommandString )
+static BaseType_t prvTokenizeCommand( const char *pcCommandString, CLI_Argument_t *pxArgv, BaseType_t xMaxArguments )
 {
-int8_t cParameters = 0;
-BaseType_t xLastCharacterWasSpace = pdFALSE;
+BaseType_t xWords = 0;
+const char *pcWordStart;
 
-	/* Count the number of space delimited words in pcCommandString. */
 	while( *pcCommandString != 0x00 )
 	{
-		if( ( *pcCommandString ) == ' ' )
+		/* Skip the spaces in front of the word. */
+		if( *pcCommandString == ' ' )
 		{
-			if( xLastCharacterWasSpace != pdTRUE )
-			{
-				cParameters++;
-				xLastCharacterWasSpace = pdTRUE;
-			}
+			pcCommandString++;
+			continue;
 		}
-		else
+
+		pcWordStart = pcCommandString;
+		while( ( *pcCommandString != 0x00 ) && ( *pcCommandString != ' ' ) )
 		{
-			xLastCharacterWasSpace = pdFALSE;
+			pcCommandString++;
 		}
 
-		pcCommandString++;
+		if( xWords < xMaxArguments )
+		{
+			pxArgv[ xWords ].pcArgument = pcWordStart;
+			pxArgv[ xWords ].xArgumentLength = ( BaseType_t ) ( pcCommandString - pcWordStart );
+		}
+
+		xWords++;
 	}
 
-	/* If the command string ended with spaces, then there will have been too
-	many parameters counted. */
-	if( xLastCharacterWasSpace == pdTRUE )
+	return xWords;
+}
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvAddCommand( const CLI_Command_Definition_t * const pxCommandToRegister )
+{
+CLI_Definition_List_Item_t *pxNewListItem;
+uint32_t ulSlot;
+
+	if( uxRegisteredCommandCount == 0 )
+	{
+		/* First registration, the help command is always the first one. */
+		memset( usCommandHashTable, 0xFF, sizeof( usCommandHashTable ) );
+
+		if( pxCommandToRegister != &xHelpCommand )
+		{
+			( void ) prvAddCommand( &xHelpCommand );
+		}
+	}
+
+	if( uxRegisteredCommandCount >= configCOMMAND_INT_MAX_COMMANDS )
+	{
+		return pdFAIL;
+	}
+
+	/* Reference the command being registered from the next free entry of
+	the table. */
+	pxNewListItem = &xRegisteredCommands[ uxRegisteredCommandCount ];
+	pxNewListItem->pxCommandLineDefinition = pxCommandToRegister;
+	pxNewListItem->xCommandStringLength = strlen( pxCommandToRegister->pcCommand );
+	pxNewListItem->ulHash = prvHashCommand( pxCommandToRegister->pcCommand, pxNewListItem->xCommandStringLength );
+
+	/* Linear probing for a free slot, the hash table is never full as it is
+	at least twice the size of the command table. */
+	ulSlot = pxNewListItem->ulHash & ( cliHASH_TABLE_SIZE - 1U );
+	while( usCommandHashTable[ ulSlot ] != cliHASH_SLOT_EMPTY )
+	{
+		ulSlot = ( ulSlot + 1U ) & ( cliHASH_TABLE_SIZE - 1U );
+	}
+
+	usCommandHashTable[ ulSlot ] = ( uint16_t ) uxRegisteredCommandCount;
+	uxRegisteredCommandCount++;
+
+	return pdPASS;
+}
+/*-----------------------------------------------------------*/
+
+static const CLI_Definition_List_Item_t *prvFindCommand( const char *pcCommandName, size_t xCommandStringLength )
+{
+const CLI_Definition_List_Item_t *pxCommand;
+uint32_t ulHash, ulSlot;
+
+	if( uxRegisteredCommandCount == 0 )
+	{
+		/* No command was registered, only the help command is available. */
+		taskENTER_CRITICAL();
+		{
+			( void ) prvAddCommand( &xHelpCommand );
+		}
+		taskEXIT_CRITICAL();
+	}
+
+	ulHash = prvHashCommand( pcCommandName, xCommandStringLength );
+
+	/* The probe sequence ends at the first empty slot.  Only the commands with
+	the same hash and length are compared, so the lookup does not depend on
+	the number of registered commands. */
+	for( ulSlot = ulHash & ( cliHASH_TABLE_SIZE - 1U ); usCommandHashTable[ ulSlot ] != cliHASH_SLOT_EMPTY; ulSlot = ( ulSlot + 1U ) & ( cliHASH_TABLE_SIZE - 1U ) )
+	{
+		pxCommand = &xRegisteredCommands[ usCommandHashTable[ ulSlot ] ];
+
+		if( ( pxCommand->ulHash == ulHash ) &&
+			( pxCommand->xCommandStringLength == xCommandStringLength ) &&
+			( memcmp( pxCommand->pxCommandLineDefinition->pcCommand, pcCommandName, xCommandStringLength ) == 0 ) )
+		{
+			return pxCommand;
+		}
+	}
+
+	return NULL;
+}
+/*-----------------------------------------------------------*/
+
+static uint32_t prvHashCommand( const char *pcString, size_t xLength )
+{
+uint32_t ulHash = 2166136261UL;
+size_t x;
+
+	/* 32-bit FNV-1a. */
+	for( x = 0; x < xLength; x++ )
 	{
-		cParameters--;
+		ulHash ^= ( uint8_t ) pcString[ x ];
+		ulHash *= 16777619UL;
 	}
 
-	/* The value returned is one less than the number of space delimited words,
-	as the first word should be the command itself. */
-	return cParameters;
+	return ulHash;
 }
 
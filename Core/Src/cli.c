@@ -2,6 +2,8 @@
  *
  */
 
+#define LOG_MODULE LOG_MODULE_CLI
+
 #include "cli.h"
 #include "log_and_cli_io.h"
 #include "stm32f4xx_hal.h"
@@ -13,6 +15,9 @@
 /* Dimensions the buffer into which input characters are placed. */
 #define cmdMAX_INPUT_SIZE					50
 
+/* Maximum number of input characters processed per wake-up of the CLI task. */
+#define cmdMAX_INPUT_CHUNK_SIZE				32
+
 /* DEL acts as a backspace. */
 #define cmdASCII_DEL						( 0x7F )
 
@@ -26,7 +31,7 @@ static const char * const welcome_message = "\r\n\r\nFreeRTOS command server.\r\
 static const char * const end_message     = "\r\n[Press ENTER to execute the previous command again]\r\n>";
 static const char * const new_line        = "\r\n";
 static char cli_input_buffer[ cmdMAX_INPUT_SIZE ];
-static char *cli_output_buffer = NULL;
+static char cli_output_buffer[ configCOMMAND_INT_MAX_OUTPUT_SIZE ];
 static char last_input_string[ cmdMAX_INPUT_SIZE ];
 static uint8_t input_index = 0;
 
@@ -40,21 +45,19 @@ static cli_callback_t commandline_interpreter = NULL;
 
 /**
   * @brief  Initializes the Commandline Interface
-  * @param	output_buffer points to a global buffer where command
-  * 		output string can be stored
   * @param  cli_callback function pointer points to the command line
   * 		interpreter function
   * @retval None
   * @note   This function will create the CLI task that implements
   * 		command line processing
+  * @note	The command output is formatted into a CLI buffer and only its
+  * 		length is reserved in the UART TX ring buffer, so the commands
+  * 		can log
   */
-void cli_init(char *output_buffer, cli_callback_t cli_callback)
+void cli_init(cli_callback_t cli_callback)
 {
 	register_commands();
 
-	cli_output_buffer = output_buffer;
-	assert_param(NULL != cli_output_buffer);
-
 	commandline_interpreter = cli_callback;
 	assert_param(NULL != cli_callback);
 
@@ -80,7 +83,6 @@ void cli_init(char *output_buffer, cli_callback_t cli_callback)
 void cli_deinit(void)
 {
 	vTaskDelete(cli_task_handle);
-	cli_output_buffer 		= NULL;
 	commandline_interpreter = NULL;
 }
 
@@ -93,24 +95,33 @@ void cli_deinit(void)
 static void cli_task(void * params)
 {
 	( void ) params;
-	char received_char;
+	char received_chars[ cmdMAX_INPUT_CHUNK_SIZE ];
 
 	/* Send the welcome message. */
 	cli_io_write( welcome_message, strlen( welcome_message ) );
 
 	for( ;; )
 	{
-		if( pdTRUE == (BaseType_t)cli_io_read((uint8_t *)&received_char)) {
-			/* Echo the character back. */
-			cli_io_write( &received_char, sizeof( received_char ) );
+		/* Wait for input, then take everything that has arrived so far. */
+		const size_t received = cli_io_read_bulk( (uint8_t *)received_chars, sizeof( received_chars ), portMAX_DELAY );
+
+		/* The received characters are echoed back with one write per chunk,
+		or per line so the echo precedes the output of the command. */
+		size_t echo_start = 0;
 
+		for( size_t i = 0; i < received; i++ ) {
 			/* Was it the end of the line? */
-			if (true == is_end_of_line(received_char)) {
+			if (true == is_end_of_line(received_chars[ i ])) {
+				cli_io_write( &received_chars[ echo_start ], (uint16_t)( i + 1 - echo_start ) );
+				echo_start = i + 1;
+
 				process_command();				
 			} else {
-				process_input(&received_char);
+				process_input(&received_chars[ i ]);
 			}
 		}
+
+		cli_io_write( &received_chars[ echo_start ], (uint16_t)( received - echo_start ) );
 	}
 }
 
@@ -194,11 +205,15 @@ static void process_command(void)
 	portBASE_TYPE xReturned;
 	
 	do {
-		/* Get the next output string from the command interpreter. */
+		/* Get the next output string from the command interpreter. The commands format whole tables in one call,
+		so the string is built in the CLI buffer and only its length is reserved in the UART TX ring buffer once the
+		command has returned. A reservation held while the command runs would block its log messages behind it. */
+		cli_output_buffer[ 0 ] = '\0';
+
 		xReturned = commandline_interpreter( cli_input_buffer, cli_output_buffer, configCOMMAND_INT_MAX_OUTPUT_SIZE );
 	
-		/* Write the generated string to the UART. */
-		cli_io_write( cli_output_buffer, strlen( cli_output_buffer ) );
+		/* Write the generated string to the UART, without the terminating null character. */
+		cli_io_write( cli_output_buffer, (uint16_t)strnlen( cli_output_buffer, configCOMMAND_INT_MAX_OUTPUT_SIZE ) );
 	
 	} while( xReturned != pdFALSE );
 
@@ -1,3 +1,5 @@
+#define LOG_MODULE LOG_MODULE_CLI
+
 /* FreeRTOS includes. */
 #include "FreeRTOS.h"
 #include "task.h"
@@ -13,11 +15,28 @@
 #include "FreeRTOS_CLI.h"
 
 #include "rtc.h"
+#include "timestamp.h"
+#include "log_and_cli_io.h"
+#include "log.h"
+#include "irq_stats.h"
+#include "cpu_load.h"
 
 #ifndef  configINCLUDE_TRACE_RELATED_CLI_COMMANDS
 	#define configINCLUDE_TRACE_RELATED_CLI_COMMANDS 0
 #endif
 
+/* Maximum number of tasks listed by the task-stats and run-time-stats
+commands, the task states are snapshotted into a static array of this size. */
+#ifndef  cmdMAX_TASKS_IN_STATS
+	#define cmdMAX_TASKS_IN_STATS 16
+#endif
+
+/* Number of times the printf-cycles command runs each conversion, the
+fastest run is reported. */
+#ifndef  cmdPRINTF_CYCLES_RUNS
+	#define cmdPRINTF_CYCLES_RUNS 16
+#endif
+
 
 /*
  * Implements the run-time-stats command.
@@ -29,15 +48,20 @@ static portBASE_TYPE prvTaskStatsCommand( char *pcWriteBuffer, size_t xWriteBuff
  */
 static portBASE_TYPE prvRunTimeStatsCommand( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString );
 
+/*
+ * Takes the task state snapshot used by the task-stats and run-time-stats commands.
+ */
+static portBASE_TYPE prvTakeTaskSnapshot( char *pcWriteBuffer, size_t xWriteBufferLen );
+
 /*
  * Implements the echo-three-parameters command.
  */
-static portBASE_TYPE prvThreeParameterEchoCommand( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString );
+static portBASE_TYPE prvThreeParameterEchoCommand( char *pcWriteBuffer, size_t xWriteBufferLen, BaseType_t xArgc, const CLI_Argument_t *pxArgv );
 
 /*
  * Implements the echo-parameters command.
  */
-static portBASE_TYPE prvParameterEchoCommand( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString );
+static portBASE_TYPE prvParameterEchoCommand( char *pcWriteBuffer, size_t xWriteBufferLen, BaseType_t xArgc, const CLI_Argument_t *pxArgv );
 
 /*
  * Implements the "trace start" and "trace stop" commands;
@@ -52,12 +76,19 @@ static portBASE_TYPE get_date( char *pcWriteBuffer, size_t xWriteBufferLen, cons
 static portBASE_TYPE get_time( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString );
 static portBASE_TYPE set_date( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString );
 static portBASE_TYPE set_time( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString );
+static portBASE_TYPE get_io_stats( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString );
+static portBASE_TYPE log_level( char *pcWriteBuffer, size_t xWriteBufferLen, BaseType_t xArgc, const CLI_Argument_t *pxArgv );
+static portBASE_TYPE get_tx_latency( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString );
+static portBASE_TYPE get_irq_stats( char *pcWriteBuffer, size_t xWriteBufferLen, BaseType_t xArgc, const CLI_Argument_t *pxArgv );
+static portBASE_TYPE top( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString );
+static portBASE_TYPE printf_cycles( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString );
 
 static void convert_time_to_string(uint8_t hours, uint8_t minutes, uint8_t seconds, char *time_string);
 static void convert_date_to_string(uint8_t day, uint8_t month, uint8_t year, char *date_string);
 static void convert_string_to_time(uint8_t *hours, uint8_t *minutes, uint8_t *seconds, const char *time_string);
 static void convert_string_to_date(uint8_t *day, uint8_t *month, uint8_t *year, const char *date_string);
 static bool is_number(char s);
+static bool is_param_equal(const char *param, BaseType_t len, const char *s);
 static bool is_time_command_string_valid(const char *time_string, BaseType_t len);
 static bool is_date_command_string_valid(const char *date_string, BaseType_t len);
 
@@ -88,8 +119,9 @@ static const CLI_Command_Definition_t xThreeParameterEcho =
 {
 	"echo-3-parameters",
 	"\r\necho-3-parameters <param1> <param2> <param3>:\r\n Expects three parameters, echos each in turn\r\n",
-	prvThreeParameterEchoCommand, /* The function to run. */
-	3 /* Three parameters are expected, which can take any value. */
+	NULL, /* The argument vector callback is used instead. */
+	3, /* Three parameters are expected, which can take any value. */
+	prvThreeParameterEchoCommand /* The function to run. */
 };
 
 /* Structure that defines the "echo_parameters" command line command.  This
@@ -99,8 +131,9 @@ static const CLI_Command_Definition_t xParameterEcho =
 {
 	"echo-parameters",
 	"\r\necho-parameters <...>:\r\n Take variable number of parameters, echos each in turn\r\n",
-	prvParameterEchoCommand, /* The function to run. */
-	-1 /* The user can enter any number of commands. */
+	NULL, /* The argument vector callback is used instead. */
+	-1, /* The user can enter any number of commands. */
+	prvParameterEchoCommand /* The function to run. */
 };
 
 #if configINCLUDE_TRACE_RELATED_CLI_COMMANDS == 1
@@ -158,6 +191,98 @@ static const CLI_Command_Definition_t set_time_cmd =
 	1
 };
 
+static const CLI_Command_Definition_t io_stats_cmd =
+{
+	"io-stats",
+	"\r\nio-stats:\r\n Displays the UART TX batching, UART RX, dropped log message and printf format cache statistics\r\n",
+	get_io_stats,
+	0
+};
+
+static const CLI_Command_Definition_t log_level_cmd =
+{
+	"log-level",
+	"\r\nlog-level [<module | all> <debug | info | warning | error | off>]:\r\n Displays or sets the lowest level logged by each module\r\n",
+	NULL, /* The argument vector callback is used instead. */
+	-1,
+	log_level
+};
+
+static const CLI_Command_Definition_t tx_latency_cmd =
+{
+	"tx-latency",
+	"\r\ntx-latency:\r\n Displays the histogram of the time from commit to transmission of the UART TX messages per lane\r\n",
+	get_tx_latency,
+	0
+};
+
+static const CLI_Command_Definition_t irq_stats_cmd =
+{
+	"irq-stats",
+	"\r\nirq-stats [reset]:\r\n Displays or clears the execution count and CPU time of the interrupt handlers\r\n",
+	NULL, /* The argument vector callback is used instead. */
+	-1,
+	get_irq_stats
+};
+
+static const CLI_Command_Definition_t top_cmd =
+{
+	"top",
+	"\r\ntop:\r\n Displays the CPU load of each FreeRTOS task over the last 1, 10 and 60 seconds, press ENTER to refresh\r\n",
+	top,
+	0
+};
+
+static const CLI_Command_Definition_t printf_cycles_cmd =
+{
+	"printf-cycles",
+	"\r\nprintf-cycles:\r\n Displays the CPU cycles snprintf takes for integer and floating point conversions with and without the format cache (built with PRINTF_FORMAT_CACHE_SIZE), measured with the DWT cycle counter\r\n",
+	printf_cycles,
+	0
+};
+
+/* The argument type of a printf-cycles conversion */
+typedef enum {
+	PRINTF_CYCLES_LONG,
+	PRINTF_CYCLES_LONG_LONG,
+	PRINTF_CYCLES_DOUBLE
+} printf_cycles_arg_t;
+
+/* The conversions timed by the printf-cycles command, value or real is
+passed for every conversion of the format */
+typedef struct {
+	const char          *format;
+	uint64_t             value;
+	double               real;
+	printf_cycles_arg_t  arg;
+} printf_cycles_case_t;
+
+static const printf_cycles_case_t printf_cycles_cases[] =
+{
+	{ "%lu",                                  7U,                    0.0,      PRINTF_CYCLES_LONG      },
+	{ "%lu",                                  4000000000U,           0.0,      PRINTF_CYCLES_LONG      },
+	{ "%ld",                                  1234567U,              0.0,      PRINTF_CYCLES_LONG      },
+	{ "%08lx",                                0xDEADBEEFU,           0.0,      PRINTF_CYCLES_LONG      },
+	{ "%lo",                                  01234567U,             0.0,      PRINTF_CYCLES_LONG      },
+	{ "%llu",                                 1234567890123ULL,      0.0,      PRINTF_CYCLES_LONG_LONG },
+	{ "%llu",                                 UINT64_MAX,            0.0,      PRINTF_CYCLES_LONG_LONG },
+	{ "%llx",                                 0x0123456789ABCDEFULL, 0.0,      PRINTF_CYCLES_LONG_LONG },
+	{ "[%02lu:%02lu:%02lu.%06lu] ",           59U,                   0.0,      PRINTF_CYCLES_LONG      },
+	{ "%lu messages, %lu bytes, %lu max\r\n", 123456U,               0.0,      PRINTF_CYCLES_LONG      },
+	{ "%.2f",                                 0U,                    23.45,    PRINTF_CYCLES_DOUBLE    },
+	{ "%.3f",                                 0U,                    -3.2999,  PRINTF_CYCLES_DOUBLE    },
+	{ "%f",                                   0U,                    0.1,      PRINTF_CYCLES_DOUBLE    },
+	{ "%e",                                   0U,                    1.25e-7,  PRINTF_CYCLES_DOUBLE    },
+	{ "%.3g",                                 0U,                    1849.37,  PRINTF_CYCLES_DOUBLE    }
+};
+
+/* printf-cycles copies the formats here to time them without the format
+cache, which only holds formats in flash */
+#define PRINTF_CYCLES_FORMAT_SIZE	48
+
+
+#define PRINTF_CYCLES_CASE_COUNT	( sizeof( printf_cycles_cases ) / sizeof( printf_cycles_cases[ 0 ] ) )
+
 
 /*-----------------------------------------------------------*/
 
@@ -173,6 +298,12 @@ void register_commands( void )
 	FreeRTOS_CLIRegisterCommand( &get_time_cmd );
 	FreeRTOS_CLIRegisterCommand( &set_date_cmd );
 	FreeRTOS_CLIRegisterCommand( &set_time_cmd );
+	FreeRTOS_CLIRegisterCommand( &io_stats_cmd );
+	FreeRTOS_CLIRegisterCommand( &log_level_cmd );
+	FreeRTOS_CLIRegisterCommand( &tx_latency_cmd );
+	FreeRTOS_CLIRegisterCommand( &irq_stats_cmd );
+	FreeRTOS_CLIRegisterCommand( &top_cmd );
+	FreeRTOS_CLIRegisterCommand( &printf_cycles_cmd );
 
 	#if( configINCLUDE_TRACE_RELATED_CLI_COMMANDS == 1 )
 	{
@@ -182,66 +313,140 @@ void register_commands( void )
 }
 /*-----------------------------------------------------------*/
 
+/* The snapshot shared by the task-stats and run-time-stats commands.  The
+commands are only run from the CLI task, one at a time. */
+static TaskStatus_t xTaskSnapshot[ cmdMAX_TASKS_IN_STATS ];
+static UBaseType_t uxTaskSnapshotCount = 0;
+static configRUN_TIME_COUNTER_TYPE ulTaskSnapshotTotalRunTime = 0;
+
+static portBASE_TYPE prvTakeTaskSnapshot( char *pcWriteBuffer, size_t xWriteBufferLen )
+{
+	/* The scheduler is only suspended while the task states are copied, the
+	rows are formatted later from the snapshot. */
+	uxTaskSnapshotCount = uxTaskGetSystemState( xTaskSnapshot, cmdMAX_TASKS_IN_STATS, &ulTaskSnapshotTotalRunTime );
+
+	if( uxTaskSnapshotCount == 0 )
+	{
+		snprintf( pcWriteBuffer, xWriteBufferLen, "More than %d tasks, increase cmdMAX_TASKS_IN_STATS.\r\n", cmdMAX_TASKS_IN_STATS );
+		return pdFALSE;
+	}
+
+	return pdTRUE;
+}
+/*-----------------------------------------------------------*/
+
 static portBASE_TYPE prvTaskStatsCommand( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString )
 {
 const char *const pcHeader = "Task          State  Priority  Stack	#\r\n************************************************\r\n";
+static UBaseType_t uxRow = 0;
+char cStatus;
 
-	/* Remove compile time warnings about unused parameters, and check the
-	write buffer is not NULL.  NOTE - for simplicity, this example assumes the
-	write buffer length is adequate, so does not check for buffer overflows. */
 	( void ) pcCommandString;
-	( void ) xWriteBufferLen;
 	configASSERT( pcWriteBuffer );
 
-	/* Generate a table of task stats. */
-	strcpy( pcWriteBuffer, pcHeader );
-	vTaskList( pcWriteBuffer + strlen( pcHeader ) );
+	/* The first call takes the snapshot and returns the header, each
+	following call returns one row of it. */
+	if( uxRow == 0 )
+	{
+		if( prvTakeTaskSnapshot( pcWriteBuffer, xWriteBufferLen ) == pdFALSE )
+		{
+			return pdFALSE;
+		}
 
-	/* There is no more data to return after this single string, so return
-	pdFALSE. */
-	return pdFALSE;
+		strncpy( pcWriteBuffer, pcHeader, xWriteBufferLen );
+		uxRow = 1;
+		return pdTRUE;
+	}
+
+	const TaskStatus_t *pxTask = &xTaskSnapshot[ uxRow - 1 ];
+
+	switch( pxTask->eCurrentState )
+	{
+		case eRunning:		cStatus = 'X'; break;
+		case eReady:		cStatus = 'R'; break;
+		case eBlocked:		cStatus = 'B'; break;
+		case eSuspended:	cStatus = 'S'; break;
+		case eDeleted:		cStatus = 'D'; break;
+		default:			cStatus = '?'; break;
+	}
+
+	snprintf( pcWriteBuffer, xWriteBufferLen, "%-*s\t%c\t%u\t%u\t%u\r\n", ( int ) ( configMAX_TASK_NAME_LEN - 1 ), pxTask->pcTaskName,
+			cStatus, ( unsigned int ) pxTask->uxCurrentPriority, ( unsigned int ) pxTask->usStackHighWaterMark, ( unsigned int ) pxTask->xTaskNumber );
+
+	uxRow++;
+	if( uxRow > uxTaskSnapshotCount )
+	{
+		uxRow = 0;
+		return pdFALSE;
+	}
+
+	return pdTRUE;
 }
 /*-----------------------------------------------------------*/
 
 static portBASE_TYPE prvRunTimeStatsCommand( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString )
 {
 const char * const pcHeader = "Task            Abs Time      % Time\r\n****************************************\r\n";
+static UBaseType_t uxRow = 0;
 
-	/* Remove compile time warnings about unused parameters, and check the
-	write buffer is not NULL.  NOTE - for simplicity, this example assumes the
-	write buffer length is adequate, so does not check for buffer overflows. */
 	( void ) pcCommandString;
-	( void ) xWriteBufferLen;
 	configASSERT( pcWriteBuffer );
 
-	/* Generate a table of task stats. */
-	strcpy( pcWriteBuffer, pcHeader );
-	vTaskGetRunTimeStats( pcWriteBuffer + strlen( pcHeader ) );
+	/* The first call takes the snapshot and returns the header, each
+	following call returns one row of it. */
+	if( uxRow == 0 )
+	{
+		if( prvTakeTaskSnapshot( pcWriteBuffer, xWriteBufferLen ) == pdFALSE )
+		{
+			return pdFALSE;
+		}
 
-	/* There is no more data to return after this single string, so return
-	pdFALSE. */
-	return pdFALSE;
+		strncpy( pcWriteBuffer, pcHeader, xWriteBufferLen );
+		uxRow = 1;
+		return pdTRUE;
+	}
+
+	const TaskStatus_t *pxTask = &xTaskSnapshot[ uxRow - 1 ];
+
+	/* For percentage calculations. */
+	const configRUN_TIME_COUNTER_TYPE ulOnePercent = ulTaskSnapshotTotalRunTime / 100U;
+	const configRUN_TIME_COUNTER_TYPE ulPercentage = ( ulOnePercent > 0U ) ? ( pxTask->ulRunTimeCounter / ulOnePercent ) : 0U;
+
+	if( ulPercentage > 0U )
+	{
+		snprintf( pcWriteBuffer, xWriteBufferLen, "%-*s\t%llu\t\t%llu%%\r\n", ( int ) ( configMAX_TASK_NAME_LEN - 1 ), pxTask->pcTaskName,
+				( unsigned long long ) pxTask->ulRunTimeCounter, ( unsigned long long ) ulPercentage );
+	}
+	else
+	{
+		/* If the percentage is zero here then the task has consumed less than 1% of the total run time. */
+		snprintf( pcWriteBuffer, xWriteBufferLen, "%-*s\t%llu\t\t<1%%\r\n", ( int ) ( configMAX_TASK_NAME_LEN - 1 ), pxTask->pcTaskName,
+				( unsigned long long ) pxTask->ulRunTimeCounter );
+	}
+
+	uxRow++;
+	if( uxRow > uxTaskSnapshotCount )
+	{
+		uxRow = 0;
+		return pdFALSE;
+	}
+
+	return pdTRUE;
 }
 /*-----------------------------------------------------------*/
 
-static portBASE_TYPE prvThreeParameterEchoCommand( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString )
+static portBASE_TYPE prvThreeParameterEchoCommand( char *pcWriteBuffer, size_t xWriteBufferLen, BaseType_t xArgc, const CLI_Argument_t *pxArgv )
 {
-const char *pcParameter;
-portBASE_TYPE xParameterStringLength, xReturn;
+portBASE_TYPE xReturn;
 static portBASE_TYPE lParameterNumber = 0;
 
-	/* Remove compile time warnings about unused parameters, and check the
-	write buffer is not NULL.  NOTE - for simplicity, this example assumes the
-	write buffer length is adequate, so does not check for buffer overflows. */
-	( void ) pcCommandString;
-	( void ) xWriteBufferLen;
 	configASSERT( pcWriteBuffer );
 
 	if( lParameterNumber == 0 )
 	{
 		/* The first time the function is called after the command has been
 		entered just a header string is returned. */
-		sprintf( pcWriteBuffer, "The three parameters were:\r\n" );
+		snprintf( pcWriteBuffer, xWriteBufferLen, "The three parameters were:\r\n" );
 
 		/* Next time the function is called the first parameter will be echoed
 		back. */
@@ -253,22 +458,12 @@ static portBASE_TYPE lParameterNumber = 0;
 	}
 	else
 	{
-		/* Obtain the parameter string. */
-		pcParameter = FreeRTOS_CLIGetParameter
-							(
-								pcCommandString,		/* The command string itself. */
-								lParameterNumber,		/* Return the next parameter. */
-								&xParameterStringLength	/* Store the parameter string length. */
-							);
-
-		/* Sanity check something was returned. */
-		configASSERT( pcParameter );
+		/* The number of parameters was checked by the command interpreter. */
+		configASSERT( lParameterNumber < xArgc );
 
 		/* Return the parameter string. */
-		memset( pcWriteBuffer, 0x00, xWriteBufferLen );
-		sprintf( pcWriteBuffer, "%d: ", ( int ) lParameterNumber );
-		strncat( pcWriteBuffer, pcParameter, xParameterStringLength );
-		strncat( pcWriteBuffer, "\r\n", strlen( "\r\n" ) );
+		snprintf( pcWriteBuffer, xWriteBufferLen, "%d: %.*s\r\n", ( int ) lParameterNumber,
+				( int ) pxArgv[ lParameterNumber ].xArgumentLength, pxArgv[ lParameterNumber ].pcArgument );
 
 		/* If this is the last of the three parameters then there are no more
 		strings to return after this one. */
@@ -291,24 +486,18 @@ static portBASE_TYPE lParameterNumber = 0;
 }
 /*-----------------------------------------------------------*/
 
-static portBASE_TYPE prvParameterEchoCommand( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString )
+static portBASE_TYPE prvParameterEchoCommand( char *pcWriteBuffer, size_t xWriteBufferLen, BaseType_t xArgc, const CLI_Argument_t *pxArgv )
 {
-const char *pcParameter;
-portBASE_TYPE xParameterStringLength, xReturn;
+portBASE_TYPE xReturn;
 static portBASE_TYPE lParameterNumber = 0;
 
-	/* Remove compile time warnings about unused parameters, and check the
-	write buffer is not NULL.  NOTE - for simplicity, this example assumes the
-	write buffer length is adequate, so does not check for buffer overflows. */
-	( void ) pcCommandString;
-	( void ) xWriteBufferLen;
 	configASSERT( pcWriteBuffer );
 
 	if( lParameterNumber == 0 )
 	{
 		/* The first time the function is called after the command has been
 		entered just a header string is returned. */
-		sprintf( pcWriteBuffer, "The parameters were:\r\n" );
+		snprintf( pcWriteBuffer, xWriteBufferLen, "The parameters were:\r\n" );
 
 		/* Next time the function is called the first parameter will be echoed
 		back. */
@@ -318,40 +507,28 @@ static portBASE_TYPE lParameterNumber = 0;
 		back yet. */
 		xReturn = pdPASS;
 	}
+	else if( lParameterNumber < xArgc )
+	{
+		/* Return the parameter string, the words were split once by the
+		command interpreter so this does not scan the command string. */
+		snprintf( pcWriteBuffer, xWriteBufferLen, "%d: %.*s\r\n", ( int ) lParameterNumber,
+				( int ) pxArgv[ lParameterNumber ].xArgumentLength, pxArgv[ lParameterNumber ].pcArgument );
+
+		/* There might be more parameters to return after this one. */
+		xReturn = pdTRUE;
+		lParameterNumber++;
+	}
 	else
 	{
-		/* Obtain the parameter string. */
-		pcParameter = FreeRTOS_CLIGetParameter
-							(
-								pcCommandString,		/* The command string itself. */
-								lParameterNumber,		/* Return the next parameter. */
-								&xParameterStringLength	/* Store the parameter string length. */
-							);
+		/* No more parameters were found.  Make sure the write buffer does
+		not contain a valid string. */
+		pcWriteBuffer[ 0 ] = 0x00;
 
-		if( pcParameter != NULL )
-		{
-			/* Return the parameter string. */
-			memset( pcWriteBuffer, 0x00, xWriteBufferLen );
-			sprintf( pcWriteBuffer, "%d: ", ( int ) lParameterNumber );
-			strncat( pcWriteBuffer, pcParameter, xParameterStringLength );
-			strncat( pcWriteBuffer, "\r\n", strlen( "\r\n" ) );
+		/* No more data to return. */
+		xReturn = pdFALSE;
 
-			/* There might be more parameters to return after this one. */
-			xReturn = pdTRUE;
-			lParameterNumber++;
-		}
-		else
-		{
-			/* No more parameters were found.  Make sure the write buffer does
-			not contain a valid string. */
-			pcWriteBuffer[ 0 ] = 0x00;
-
-			/* No more data to return. */
-			xReturn = pdFALSE;
-
-			/* Start over the next time this command is executed. */
-			lParameterNumber = 0;
-		}
+		/* Start over the next time this command is executed. */
+		lParameterNumber = 0;
 	}
 
 	return xReturn;
@@ -517,6 +694,7 @@ static portBASE_TYPE set_time( char *pcWriteBuffer, size_t xWriteBufferLen, cons
 		convert_string_to_time(&hours, &minutes, &seconds, time_to_set);
 
 		RTC_SetTime(hours, minutes, seconds);
+		timestamp_sync();
 		char *time_set_to_string = "\r\nTime set to ";
 		strcpy(pcWriteBuffer, time_set_to_string);
 
@@ -531,6 +709,109 @@ static portBASE_TYPE set_time( char *pcWriteBuffer, size_t xWriteBufferLen, cons
 	return pdFALSE;
 }
 
+static portBASE_TYPE get_io_stats( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString )
+{
+	( void ) pcCommandString;
+	configASSERT( pcWriteBuffer );
+
+	uart_tx_stats_t stats;
+	log_and_cli_io_get_tx_stats(&stats);
+
+	uart_rx_stats_t rx_stats;
+	log_and_cli_io_get_rx_stats(&rx_stats);
+
+	log_drop_stats_t drops;
+	log_and_cli_io_get_drop_stats(&drops);
+
+	unsigned long format_hits;
+	unsigned long format_misses;
+	printf_format_cache_stats(&format_hits, &format_misses);
+
+	uint32_t messages_per_dma = 0;
+	uint32_t bytes_per_dma    = 0;
+	uint32_t format_hit_rate  = 0;	/* per mille */
+
+	if (0 != stats.dma_transfers) {
+		messages_per_dma = (uint32_t)(((uint64_t)stats.messages * 100U) / stats.dma_transfers);
+		bytes_per_dma    = stats.bytes / stats.dma_transfers;
+	}
+
+	if (0 != (format_hits + format_misses)) {
+		format_hit_rate = (uint32_t)(((uint64_t)format_hits * 1000U) / (format_hits + format_misses));
+	}
+
+	snprintf(pcWriteBuffer, xWriteBufferLen,
+			"\r\nDMA transfers:    %lu\r\n"
+			"Messages:         %lu\r\n"
+			"Bytes:            %lu\r\n"
+			"Messages per DMA: %lu.%02lu avg, %lu max\r\n"
+			"Bytes per DMA:    %lu avg, %lu max\r\n"
+			"RX bytes:         %lu in %lu events, %lu dropped, %lu errors\r\n"
+			"Dropped logs:     DEBUG %lu, INFO %lu, WARNING %lu, ERROR %lu\r\n"
+			"Overwritten logs: %lu\r\n"
+			"Format cache:     %lu hits, %lu misses, %lu.%lu%% hit rate\r\n",
+			stats.dma_transfers,
+			stats.messages,
+			stats.bytes,
+			messages_per_dma / 100U, messages_per_dma % 100U, stats.max_batch_messages,
+			bytes_per_dma, stats.max_batch_bytes,
+			rx_stats.bytes, rx_stats.events, rx_stats.dropped_bytes, rx_stats.errors,
+			drops.dropped[LOG_LEVEL_DEBUG], drops.dropped[LOG_LEVEL_INFO], drops.dropped[LOG_LEVEL_WARNING], drops.dropped[LOG_LEVEL_ERROR],
+			drops.overwritten,
+			format_hits, format_misses, format_hit_rate / 10U, format_hit_rate % 10U);
+
+	return pdFALSE;
+}
+
+static portBASE_TYPE log_level( char *pcWriteBuffer, size_t xWriteBufferLen, BaseType_t xArgc, const CLI_Argument_t *pxArgv )
+{
+	/* Indexed by log_level_t, the last one is LOG_LEVEL_OFF */
+	static const char * const level_names[LOG_LEVEL_OFF + 1] = { "debug", "info", "warning", "error", "off" };
+
+	configASSERT( pcWriteBuffer );
+
+	if (xArgc > 1) {
+		const char *module_param = pxArgv[1].pcArgument;
+		const BaseType_t module_len = pxArgv[1].xArgumentLength;
+		const char *level_param = (xArgc > 2) ? pxArgv[2].pcArgument : NULL;
+		const BaseType_t level_len = (xArgc > 2) ? pxArgv[2].xArgumentLength : 0;
+		uint32_t level;
+		uint32_t module;
+
+		for (level = 0; level <= LOG_LEVEL_OFF; level++) {
+			if ((NULL != level_param) && (true == is_param_equal(level_param, level_len, level_names[level]))) {
+				break;
+			}
+		}
+
+		for (module = 0; module < LOG_MODULE_COUNT; module++) {
+			if (true == is_param_equal(module_param, module_len, log_module_name((log_module_t)module))) {
+				break;
+			}
+		}
+
+		if ((level > LOG_LEVEL_OFF) ||
+			((module == LOG_MODULE_COUNT) && (true != is_param_equal(module_param, module_len, "all")))) {
+			strcpy(pcWriteBuffer, "Invalid parameter.\r\n");
+			return pdFALSE;
+		}
+
+		for (uint32_t i = 0; i < LOG_MODULE_COUNT; i++) {
+			if ((i == module) || (module == LOG_MODULE_COUNT)) {
+				log_set_level((log_module_t)i, (log_level_t)level);
+			}
+		}
+	}
+
+	size_t len = 0;
+	for (uint32_t i = 0; (i < LOG_MODULE_COUNT) && (len < xWriteBufferLen); i++) {
+		len += (size_t)snprintf(pcWriteBuffer + len, xWriteBufferLen - len, "%-10s %s\r\n",
+				log_module_name((log_module_t)i), level_names[log_get_level((log_module_t)i)]);
+	}
+
+	return pdFALSE;
+}
+
 static void convert_date_to_string(uint8_t day, uint8_t month, uint8_t year, char *date_string)
 {
 	configASSERT( date_string );
@@ -623,6 +904,186 @@ static bool is_number(char s)
 	return retv;
 }
 
+static portBASE_TYPE get_tx_latency( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString )
+{
+	( void ) pcCommandString;
+	configASSERT( pcWriteBuffer );
+
+	uart_tx_latency_t urgent;
+	uart_tx_latency_t bulk;
+	log_and_cli_io_get_tx_latency(UART_TX_LANE_URGENT, &urgent);
+	log_and_cli_io_get_tx_latency(UART_TX_LANE_BULK, &bulk);
+
+	size_t len = (size_t)snprintf(pcWriteBuffer, xWriteBufferLen, "\r\nLatency [ms]   Urgent      Bulk\r\n");
+
+	for (uint32_t i = 0; (i < UART_TX_LATENCY_BUCKETS) && (len < xWriteBufferLen); i++) {
+		char range[16];
+
+		if (0 == i) {
+			snprintf(range, sizeof(range), "0");
+		} else if ((UART_TX_LATENCY_BUCKETS - 1) == i) {
+			snprintf(range, sizeof(range), ">= %lu", 1UL << (i - 1));
+		} else if (1 == i) {
+			snprintf(range, sizeof(range), "1");
+		} else {
+			snprintf(range, sizeof(range), "%lu-%lu", 1UL << (i - 1), (1UL << i) - 1);
+		}
+
+		len += (size_t)snprintf(pcWriteBuffer + len, xWriteBufferLen - len, "%-14s %-11lu %lu\r\n", range, urgent.buckets[i], bulk.buckets[i]);
+	}
+
+	if (len < xWriteBufferLen) {
+		snprintf(pcWriteBuffer + len, xWriteBufferLen - len, "%-14s %-11lu %lu\r\n", "Max", urgent.max_ms, bulk.max_ms);
+	}
+
+	return pdFALSE;
+}
+
+static portBASE_TYPE get_irq_stats( char *pcWriteBuffer, size_t xWriteBufferLen, BaseType_t xArgc, const CLI_Argument_t *pxArgv )
+{
+	configASSERT( pcWriteBuffer );
+
+	if (xArgc > 1) {
+		if (true != is_param_equal(pxArgv[1].pcArgument, pxArgv[1].xArgumentLength, "reset")) {
+			strcpy(pcWriteBuffer, "Invalid parameter.\r\n");
+		} else {
+			irq_stats_reset();
+			strcpy(pcWriteBuffer, "IRQ statistics cleared.\r\n");
+		}
+		return pdFALSE;
+	}
+
+	/* CPU cycles since the statistics were cleared, the CPU column is in per mille of it */
+	const uint64_t elapsed = irq_stats_get_elapsed_cycles();
+
+	size_t len = (size_t)snprintf(pcWriteBuffer, xWriteBufferLen, "\r\nIRQ            Count       Total [cyc]   Max [cyc]   Avg [cyc]   CPU\r\n");
+
+	for (uint32_t i = 0; (i < IRQ_STATS_COUNT) && (len < xWriteBufferLen); i++) {
+		irq_stats_t stats;
+		irq_stats_get((irq_stats_id_t)i, &stats);
+
+		const uint32_t average  = (0U == stats.count) ? 0U : (uint32_t)(stats.total_cycles / stats.count);
+		const uint32_t permille = (0U == elapsed) ? 0U : (uint32_t)((stats.total_cycles * 1000U) / elapsed);
+
+		len += (size_t)snprintf(pcWriteBuffer + len, xWriteBufferLen - len, "%-14s %-11lu %-13llu %-11lu %-11lu %lu.%lu%%\r\n",
+				irq_stats_name((irq_stats_id_t)i), stats.count, stats.total_cycles, stats.max_cycles, average, permille / 10U, permille % 10U);
+	}
+
+	return pdFALSE;
+}
+
+static portBASE_TYPE top( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString )
+{
+	/* The snapshot is taken on the first call, then one row is returned per call */
+	static cpu_load_task_t tasks[CPU_LOAD_MAX_TASKS];
+	static uint32_t task_count = 0;
+	static uint32_t row = 0;
+
+	( void ) pcCommandString;
+	configASSERT( pcWriteBuffer );
+
+	if (0 == row) {
+		task_count = cpu_load_get(tasks, CPU_LOAD_MAX_TASKS);
+		row = 1;
+
+		/* Clear the screen and move the cursor home, so that re-running the command refreshes in place */
+		snprintf(pcWriteBuffer, xWriteBufferLen, "\x1b[2J\x1b[H%-16s %-8s %-8s %s\r\n", "Task", "1s", "10s", "60s");
+	} else {
+		const cpu_load_task_t *task = &tasks[row - 1];
+		row = row + 1;
+
+		snprintf(pcWriteBuffer, xWriteBufferLen, "%-16s %3u.%u%%   %3u.%u%%   %3u.%u%%\r\n", task->name,
+				task->permille[CPU_LOAD_WINDOW_1S] / 10U,  task->permille[CPU_LOAD_WINDOW_1S] % 10U,
+				task->permille[CPU_LOAD_WINDOW_10S] / 10U, task->permille[CPU_LOAD_WINDOW_10S] % 10U,
+				task->permille[CPU_LOAD_WINDOW_60S] / 10U, task->permille[CPU_LOAD_WINDOW_60S] % 10U);
+	}
+
+	if (row > task_count) {
+		row = 0;
+		return pdFALSE;
+	}
+
+	return pdTRUE;
+}
+
+/**
+  * @brief  Measures the CPU cycles of one snprintf call
+  * @param  test the conversion to time
+  * @param  format the format of the conversion, either test->format or
+  * 		a copy in RAM
+  * @retval the cycles of the fastest of cmdPRINTF_CYCLES_RUNS runs
+  * @note	The calls run in a critical section, the fastest run is the one
+  * 		least disturbed by the interrupts above the syscall priority.
+  */
+static uint32_t printf_cycles_measure(const printf_cycles_case_t *test, const char *format)
+{
+	char output[48];
+	uint32_t best = UINT32_MAX;
+
+	for (uint32_t run = 0; run < cmdPRINTF_CYCLES_RUNS; run++) {
+		taskENTER_CRITICAL();
+		const uint32_t start = DWT->CYCCNT;
+		if (PRINTF_CYCLES_DOUBLE == test->arg) {
+			snprintf(output, sizeof(output), format, test->real);
+		} else if (PRINTF_CYCLES_LONG_LONG == test->arg) {
+			const unsigned long long value = test->value;
+			snprintf(output, sizeof(output), format, value, value, value, value);
+		} else {
+			const unsigned long value = (unsigned long)test->value;
+			snprintf(output, sizeof(output), format, value, value, value, value);
+		}
+		const uint32_t cycles = DWT->CYCCNT - start;
+		taskEXIT_CRITICAL();
+
+		if (cycles < best) {
+			best = cycles;
+		}
+	}
+
+	return best;
+}
+
+static portBASE_TYPE printf_cycles( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString )
+{
+	/* The header is returned on the first call, then one conversion per call */
+	static uint32_t row = 0;
+
+	( void ) pcCommandString;
+	configASSERT( pcWriteBuffer );
+
+	if (0 == row) {
+		snprintf(pcWriteBuffer, xWriteBufferLen, "\r\n%-8s %-12s %s\r\n", "Cached", "Interpreted", "Format");
+	} else {
+		const printf_cycles_case_t *test = &printf_cycles_cases[row - 1];
+		char format_in_ram[PRINTF_CYCLES_FORMAT_SIZE];
+
+		strncpy(format_in_ram, test->format, sizeof(format_in_ram) - 1U);
+		format_in_ram[sizeof(format_in_ram) - 1U] = '\0';
+
+		/* The first call compiles the format into the cache, the fastest run is a hit */
+		const uint32_t cached      = printf_cycles_measure(test, test->format);
+		const uint32_t interpreted = printf_cycles_measure(test, format_in_ram);
+
+		/* The line break of the format is not printed */
+		const int format_len = (int)strcspn(test->format, "\r\n");
+
+		snprintf(pcWriteBuffer, xWriteBufferLen, "%-8lu %-12lu %.*s\r\n", cached, interpreted, format_len, test->format);
+	}
+
+	row = row + 1;
+	if (row > PRINTF_CYCLES_CASE_COUNT) {
+		row = 0;
+		return pdFALSE;
+	}
+
+	return pdTRUE;
+}
+
+static bool is_param_equal(const char *param, BaseType_t len, const char *s)
+{
+	return ((size_t)len == strlen(s)) && (0 == strncmp(param, s, (size_t)len));
+}
+
 static bool is_time_command_string_valid(const char *time_string, BaseType_t len)
 {
 	bool retv = true;
@@ -0,0 +1,227 @@
+/*
+ * cpu_load.c
+ *
+ *  Created on: 2026. okt. 17.
+ *      Author: Balint
+ */
+#include "cpu_load.h"
+#include "stm32f4xx_hal.h"
+
+#include "task.h"
+#include "timers.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+/* Number of samples in each window, indexed by cpu_load_window_t */
+static const uint32_t cpu_load_window_samples[CPU_LOAD_WINDOW_COUNT] = { 1U, 10U, 60U };
+
+/**
+  * @brief  Task tracked in a column of the sample ring
+  * @note	task_number 0 marks a free slot, the kernel numbers the tasks from 1
+  */
+typedef struct {
+	UBaseType_t task_number;
+	char        name[configMAX_TASK_NAME_LEN];
+	uint64_t    last_run_time;
+	bool        seen;
+} cpu_load_slot_t;
+
+static TaskStatus_t    cpu_load_status[CPU_LOAD_MAX_TASKS];
+static cpu_load_slot_t cpu_load_slots[CPU_LOAD_MAX_TASKS];
+
+/* Run time of each slot and the total elapsed time per sample period */
+static uint32_t        cpu_load_deltas[CPU_LOAD_SAMPLE_COUNT][CPU_LOAD_MAX_TASKS];
+static uint32_t        cpu_load_totals[CPU_LOAD_SAMPLE_COUNT];
+static uint32_t        cpu_load_head;
+static uint32_t        cpu_load_sample_count;
+static uint64_t        cpu_load_last_total;
+
+static StaticTimer_t   cpu_load_timer_storage;
+static TimerHandle_t   cpu_load_timer_handle;
+
+static void cpu_load_timer_callback(TimerHandle_t timer);
+static cpu_load_slot_t *cpu_load_find_slot(UBaseType_t task_number);
+
+/**
+  * @brief  Initializes the CPU load sampling
+  * @param  None
+  * @retval None
+  * @note	The samples are taken by a software timer, in the context of the
+  * 		timer service task.
+  */
+void cpu_load_init(void)
+{
+	memset(cpu_load_slots, 0, sizeof(cpu_load_slots));
+	memset(cpu_load_deltas, 0, sizeof(cpu_load_deltas));
+	memset(cpu_load_totals, 0, sizeof(cpu_load_totals));
+	cpu_load_head         = 0;
+	cpu_load_sample_count = 0;
+	cpu_load_last_total   = 0;
+
+	cpu_load_timer_handle = xTimerCreateStatic(
+								"CPU load",
+								pdMS_TO_TICKS(CPU_LOAD_SAMPLE_PERIOD_MS),
+								pdTRUE,
+								NULL,
+								cpu_load_timer_callback,
+								&cpu_load_timer_storage);
+	assert_param(NULL != cpu_load_timer_handle);
+
+	BaseType_t ret = xTimerStart(cpu_load_timer_handle, 0);
+	assert_param(pdPASS == ret);
+}
+
+/**
+  * @brief  Deinitializes the CPU load sampling
+  * @param  None
+  * @retval None
+  */
+void cpu_load_deinit(void)
+{
+	BaseType_t ret = xTimerDelete(cpu_load_timer_handle, portMAX_DELAY);
+	assert_param(pdPASS == ret);
+}
+
+/**
+  * @brief  Gets the CPU load of the tasks over the last 1, 10 and 60 seconds
+  * @param  tasks points where the load of the tasks can be stored
+  * @param  max_tasks number of elements of tasks
+  * @retval number of tasks stored, sorted by the 1 second load in descending order
+  * @note	Until a window is filled the available samples are used.
+  */
+uint32_t cpu_load_get(cpu_load_task_t *tasks, uint32_t max_tasks)
+{
+	uint32_t count = 0;
+
+	vTaskSuspendAll();
+
+	for (uint32_t slot = 0; (slot < CPU_LOAD_MAX_TASKS) && (count < max_tasks); slot++) {
+		if (0U == cpu_load_slots[slot].task_number) {
+			continue;
+		}
+
+		cpu_load_task_t *task = &tasks[count];
+		memcpy(task->name, cpu_load_slots[slot].name, sizeof(task->name));
+		task->task_number = cpu_load_slots[slot].task_number;
+
+		for (uint32_t window = 0; window < CPU_LOAD_WINDOW_COUNT; window++) {
+			uint64_t run_time = 0;
+			uint64_t total    = 0;
+
+			for (uint32_t i = 0; (i < cpu_load_window_samples[window]) && (i < cpu_load_sample_count); i++) {
+				const uint32_t sample = (cpu_load_head + CPU_LOAD_SAMPLE_COUNT - 1U - i) % CPU_LOAD_SAMPLE_COUNT;
+				run_time = run_time + cpu_load_deltas[sample][slot];
+				total    = total + cpu_load_totals[sample];
+			}
+
+			task->permille[window] = (0U == total) ? 0U : (uint16_t)((run_time * 1000U) / total);
+		}
+
+		/* Insertion sort, the number of tasks is small */
+		uint32_t i = count;
+		while ((i > 0) && (tasks[i - 1].permille[CPU_LOAD_WINDOW_1S] < tasks[i].permille[CPU_LOAD_WINDOW_1S])) {
+			const cpu_load_task_t tmp = tasks[i - 1];
+			tasks[i - 1] = tasks[i];
+			tasks[i]     = tmp;
+			i--;
+		}
+
+		count++;
+	}
+
+	(void)xTaskResumeAll();
+
+	return count;
+}
+
+/**
+  * @brief  Takes a sample of the run time of each task
+  * @param  timer handle of the timer
+  * @retval None
+  * @note	This function is called from the timer service task. The slot of
+  * 		a deleted task is freed, a new task takes a free slot with its
+  * 		column of samples cleared.
+  */
+static void cpu_load_timer_callback(TimerHandle_t timer)
+{
+	(void)timer;
+
+	uint64_t total;
+
+	const UBaseType_t task_count = uxTaskGetSystemState(cpu_load_status, CPU_LOAD_MAX_TASKS, &total);
+	if (0U == task_count) {
+		/* More tasks than CPU_LOAD_MAX_TASKS */
+		return;
+	}
+
+	vTaskSuspendAll();
+
+	for (uint32_t slot = 0; slot < CPU_LOAD_MAX_TASKS; slot++) {
+		cpu_load_slots[slot].seen = false;
+		cpu_load_deltas[cpu_load_head][slot] = 0;
+	}
+
+	for (UBaseType_t i = 0; i < task_count; i++) {
+		cpu_load_slot_t *slot = cpu_load_find_slot(cpu_load_status[i].xTaskNumber);
+		if (NULL != slot) {
+			slot->seen = true;
+		}
+	}
+
+	/* Deleted tasks, freed first so that the new ones find a slot */
+	for (uint32_t slot = 0; slot < CPU_LOAD_MAX_TASKS; slot++) {
+		if (false == cpu_load_slots[slot].seen) {
+			cpu_load_slots[slot].task_number = 0;
+		}
+	}
+
+	for (UBaseType_t i = 0; i < task_count; i++) {
+		cpu_load_slot_t *slot = cpu_load_find_slot(cpu_load_status[i].xTaskNumber);
+
+		if (NULL == slot) {
+			/* New task, the run time since its creation is counted */
+			slot = cpu_load_find_slot(0);
+			assert_param(NULL != slot);
+
+			const uint32_t column = (uint32_t)(slot - cpu_load_slots);
+			for (uint32_t sample = 0; sample < CPU_LOAD_SAMPLE_COUNT; sample++) {
+				cpu_load_deltas[sample][column] = 0;
+			}
+
+			slot->task_number   = cpu_load_status[i].xTaskNumber;
+			slot->last_run_time = 0;
+			strncpy(slot->name, cpu_load_status[i].pcTaskName, sizeof(slot->name) - 1U);
+			slot->name[sizeof(slot->name) - 1U] = '\0';
+		}
+
+		const uint32_t column = (uint32_t)(slot - cpu_load_slots);
+		cpu_load_deltas[cpu_load_head][column] = (uint32_t)(cpu_load_status[i].ulRunTimeCounter - slot->last_run_time);
+		slot->last_run_time = cpu_load_status[i].ulRunTimeCounter;
+	}
+
+	cpu_load_totals[cpu_load_head] = (uint32_t)(total - cpu_load_last_total);
+	cpu_load_last_total            = total;
+	cpu_load_head                  = (cpu_load_head + 1U) % CPU_LOAD_SAMPLE_COUNT;
+	if (cpu_load_sample_count < CPU_LOAD_SAMPLE_COUNT) {
+		cpu_load_sample_count = cpu_load_sample_count + 1U;
+	}
+
+	(void)xTaskResumeAll();
+}
+
+/**
+  * @brief  Finds the slot of a task
+  * @param  task_number of the task, 0 finds a free slot
+  * @retval pointer to the slot, NULL if not found
+  */
+static cpu_load_slot_t *cpu_load_find_slot(UBaseType_t task_number)
+{
+	for (uint32_t slot = 0; slot < CPU_LOAD_MAX_TASKS; slot++) {
+		if (task_number == cpu_load_slots[slot].task_number) {
+			return &cpu_load_slots[slot];
+		}
+	}
+
+	return NULL;
+}
@@ -0,0 +1,92 @@
+/*
+ * irq_stats.c
+ *
+ *  Created on: 2026. okt. 17.
+ *      Author: Balint
+ */
+#include "irq_stats.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+
+irq_stats_t irq_stats[IRQ_STATS_COUNT];
+uint32_t    irq_stats_nested_cycles;
+
+static uint64_t irq_stats_reset_time;
+
+/* Indexed by irq_stats_id_t */
+static const char * const irq_stats_names[IRQ_STATS_COUNT] = {
+	"OTG_FS", "USART2", "DMA1_Stream5", "DMA1_Stream6", "TIM7"
+};
+
+/**
+  * @brief  Initializes the interrupt statistics
+  * @param  None
+  * @retval None
+  * @note	The DWT cycle counter is enabled but not reset, since SystemView
+  * 		uses it for its timestamps too.
+  */
+void irq_stats_init(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+
+	irq_stats_nested_cycles = 0;
+	irq_stats_reset();
+}
+
+/**
+  * @brief  Clears the interrupt statistics
+  * @param  None
+  * @retval None
+  */
+void irq_stats_reset(void)
+{
+	taskENTER_CRITICAL();
+	memset(irq_stats, 0, sizeof(irq_stats));
+	irq_stats_reset_time = portGET_RUN_TIME_COUNTER_VALUE();
+	taskEXIT_CRITICAL();
+}
+
+/**
+  * @brief  Gets the statistics of an interrupt
+  * @param  id of the interrupt
+  * @param  stats points where the statistics can be stored
+  * @retval None
+  */
+void irq_stats_get(irq_stats_id_t id, irq_stats_t *stats)
+{
+	assert_param(id < IRQ_STATS_COUNT);
+
+	taskENTER_CRITICAL();
+	*stats = irq_stats[id];
+	taskEXIT_CRITICAL();
+}
+
+/**
+  * @brief  Gets the number of CPU cycles since the statistics were cleared
+  * @param  None
+  * @retval elapsed CPU cycles
+  * @note	The elapsed time is measured with the 1 MHz run-time stats counter,
+  * 		since the DWT cycle counter wraps around in ~25 seconds.
+  */
+uint64_t irq_stats_get_elapsed_cycles(void)
+{
+	const uint64_t elapsed_us = portGET_RUN_TIME_COUNTER_VALUE() - irq_stats_reset_time;
+
+	return elapsed_us * (SystemCoreClock / 1000000U);
+}
+
+/**
+  * @brief  Gets the name of an interrupt
+  * @param  id of the interrupt
+  * @retval name of the interrupt
+  */
+const char *irq_stats_name(irq_stats_id_t id)
+{
+	assert_param(id < IRQ_STATS_COUNT);
+
+	return irq_stats_names[id];
+}
@@ -7,6 +7,36 @@
 #include "log.h"
 #include "log_and_cli_io.h"
 
+#include "FreeRTOS.h"
+#include "task.h"
+
+typedef struct {
+	log_policy_t policy;
+	uint32_t     timeout_ms;
+} log_policy_config_t;
+
+/* Logging must not stall the caller: info messages are dropped if the buffer
+is full, warnings wait a little, errors make room by discarding older messages */
+static log_policy_config_t log_policies[LOG_LEVEL_COUNT] = {
+	[LOG_LEVEL_DEBUG]   = { LOG_POLICY_DROP_NEWEST,      0  },
+	[LOG_LEVEL_INFO]    = { LOG_POLICY_DROP_NEWEST,      0  },
+	[LOG_LEVEL_WARNING] = { LOG_POLICY_TIMEOUT,          10 },
+	[LOG_LEVEL_ERROR]   = { LOG_POLICY_OVERWRITE_OLDEST, 50 },
+};
+
+/* Debug messages are compiled in but disabled until enabled from the CLI */
+volatile uint8_t log_module_levels[LOG_MODULE_COUNT] = {
+	[LOG_MODULE_DEFAULT] = LOG_LEVEL_INFO,
+	[LOG_MODULE_MAIN]    = LOG_LEVEL_INFO,
+	[LOG_MODULE_CLI]     = LOG_LEVEL_INFO,
+};
+
+static const char * const log_module_names[LOG_MODULE_COUNT] = {
+	[LOG_MODULE_DEFAULT] = "default",
+	[LOG_MODULE_MAIN]    = "main",
+	[LOG_MODULE_CLI]     = "cli",
+};
+
 void log_init(void)
 {
 	log_and_cli_io_init();
@@ -17,29 +47,100 @@ void log_deinit(void)
 	log_and_cli_io_deinit();
 }
 
-int log_info(const char * s, ...)
+/**
+  * @brief  Sets what the log calls of a level do when the log buffer is full
+  * @param  level the policy applies to
+  * @param  policy see log_policy_t
+  * @param  timeout_ms maximum wait for LOG_POLICY_TIMEOUT and LOG_POLICY_OVERWRITE_OLDEST
+  * @retval None
+  */
+void log_set_policy(log_level_t level, log_policy_t policy, uint32_t timeout_ms)
+{
+	configASSERT(level < LOG_LEVEL_COUNT);
+
+	taskENTER_CRITICAL();
+	log_policies[level].policy     = policy;
+	log_policies[level].timeout_ms = timeout_ms;
+	taskEXIT_CRITICAL();
+}
+
+/**
+  * @brief  Sets the lowest level of a module that is logged
+  * @param  module the threshold applies to
+  * @param  level lowest level logged, LOG_LEVEL_OFF disables the module
+  * @retval None
+  */
+void log_set_level(log_module_t module, log_level_t level)
+{
+	configASSERT(module < LOG_MODULE_COUNT);
+	configASSERT(level <= LOG_LEVEL_OFF);
+
+	log_module_levels[module] = (uint8_t)level;
+}
+
+log_level_t log_get_level(log_module_t module)
+{
+	configASSERT(module < LOG_MODULE_COUNT);
+
+	return (log_level_t)log_module_levels[module];
+}
+
+const char * log_module_name(log_module_t module)
+{
+	configASSERT(module < LOG_MODULE_COUNT);
+
+	return log_module_names[module];
+}
+
+/**
+  * @brief  Logs a message with the policy set for its level
+  * @param  level of the message
+  * @param  s string with optional format specifiers
+  * @retval length of the message, -1 if it was dropped
+  * @note	Called by log_debug, log_info, log_warning and log_error after the
+  * 		level is checked against the module threshold.
+  */
+int log_level_(log_level_t level, const char * s, ...)
 {
 	va_list va;
 	va_start(va, s);
-	int len = log_(s, "INFO", va);
+	int len = log_(s, level, log_policies[level].policy, log_policies[level].timeout_ms, va);
 	va_end(va);
 	return len;
 }
 
-int log_warning(const char * s, ...)
+/**
+  * @brief  Logs a message with a policy given for this call only
+  * @param  level of the message
+  * @param  policy see log_policy_t
+  * @param  timeout_ms maximum wait for LOG_POLICY_TIMEOUT and LOG_POLICY_OVERWRITE_OLDEST
+  * @param  s string with optional format specifiers
+  * @retval length of the message, -1 if it was dropped
+  */
+int log_with_policy_(log_level_t level, log_policy_t policy, uint32_t timeout_ms, const char * s, ...)
 {
+	configASSERT(level < LOG_LEVEL_COUNT);
+
 	va_list va;
 	va_start(va, s);
-	int len = log_(s, "WARNING", va);
+	int len = log_(s, level, policy, timeout_ms, va);
 	va_end(va);
 	return len;
 }
 
-int log_error(const char * s, ...)
+/**
+  * @brief  Logs a message from an interrupt
+  * @param  level of the message
+  * @param  s string with optional format specifiers, it and the %s arguments
+  * 		must be string literals since the message is formatted later
+  * @retval 0, -1 if the message was dropped
+  * @note	Never blocks, the message is dropped if the log buffer is full
+  */
+int log_level_from_isr_(log_level_t level, const char * s, ...)
 {
 	va_list va;
 	va_start(va, s);
-	int len = log_(s, "ERROR", va);
+	int len = log_from_isr_(s, level, va);
 	va_end(va);
 	return len;
 }
@@ -7,7 +7,10 @@
 #include "log_and_cli_io.h"
 #include "stm32f4xx_hal.h"
 #include "rtc.h"
+#include "timestamp.h"
 #include "printf.h"
+#include "ring_buffer.h"
+#include "log_record.h"
 
 #include "FreeRTOS.h"
 #include "task.h"
@@ -15,38 +18,94 @@
 #include "queue.h"
 #include "semphr.h"
 #include "event_groups.h"
+#include "stream_buffer.h"
 
 #include <string.h>
 
-typedef struct {
-	uint8_t *pbuf;
-	uint16_t size;
-} uart_tx_data_t;
+/* When set to 1 log_() only captures the timestamp, the format string address
+and the raw argument words into the log record buffer, the message is formatted
+later by the writer task. The format string and the %s arguments must point to
+storage that outlives the call (string literals). When set to 0 the message is
+formatted in the context of the caller. */
+#ifndef LOG_DEFERRED
+	#define LOG_DEFERRED							0
+#endif
+
+/* When set to 1 the writer task sends the deferred log records as compact
+binary frames (see log_record.h) instead of text. The frames are turned back
+into text on the host by Tools/log_decoder/log_decoder.py using the ELF file
+of the firmware. Requires LOG_DEFERRED. */
+#ifndef LOG_BINARY
+	#define LOG_BINARY								0
+#endif
+
+/* When set to 1 the timestamp prefix of the text log messages has a
+microsecond field, [hh:mm:ss.uuuuuu] instead of [hh:mm:ss]. */
+#ifndef LOG_TIMESTAMP_US
+	#define LOG_TIMESTAMP_US						0
+#endif
+
+#if (1 == LOG_BINARY) && (1 != LOG_DEFERRED)
+	#error "LOG_BINARY requires LOG_DEFERRED"
+#endif
 
 static void UART2_Init(void);
 static void UART2_Deinit(void);
 static void UART2_MspInit(UART_HandleTypeDef* huart);
 static void UART2_MspDeInit(UART_HandleTypeDef* huart);
 static void UART2_TxCpltCallback(UART_HandleTypeDef *huart);
-static void UART2_RxCpltCallback(UART_HandleTypeDef *huart);
-
-static SemaphoreHandle_t uart_tx_complete_semaphore_handle = NULL;
-static StaticSemaphore_t uart_tx_complete_semaphore_storage;
-
-#define UART_RX_QUEUE_LENGTH						8
-static StaticQueue_t uart_rx_queue_struct;
-static uint8_t		 uart_rx_queue_storage[UART_RX_QUEUE_LENGTH * sizeof(uint8_t)];
-static QueueHandle_t uart_rx_queue_handle			= NULL;
-
-#define UART_TX_AVAILABLE_QUEUE_LENGTH				8
-static StaticQueue_t uart_tx_available_struct;
-static uint8_t       uart_tx_available_queue_storage[UART_TX_AVAILABLE_QUEUE_LENGTH * sizeof(uint8_t *)];
-static QueueHandle_t uart_tx_available_queue_handle	= NULL;
-
-#define UART_TX_READY_QUEUE_LENGTH					8
-static StaticQueue_t uart_tx_ready_struct;
-static uint8_t		 uart_tx_ready_queue_storage[UART_TX_READY_QUEUE_LENGTH * sizeof(uart_tx_data_t)];
-static QueueHandle_t uart_tx_ready_queue_handle		= NULL;
+static void UART2_RxEventCallback(UART_HandleTypeDef *huart, uint16_t pos);
+static void UART2_ErrorCallback(UART_HandleTypeDef *huart);
+static void uart_rx_start(void);
+static void uart_tx_start_next(void);
+static void uart_tx_update_stats(uint16_t size, uint16_t count);
+static void uart_tx_update_latency(void);
+static void uart_tx_recycle(void);
+static uint8_t *uart_ring_reserve(ring_buffer_t *rb, uint16_t size, uint16_t *handle, EventBits_t space_available_bit, TickType_t ticks_to_wait);
+static uint8_t *uart_tx_reserve(uart_tx_lane_t lane, uint16_t size, uint16_t *handle);
+static void uart_tx_commit(uart_tx_lane_t lane, uint16_t handle, uint16_t size);
+static uart_tx_lane_t log_lane(log_level_t level);
+static uint8_t *log_reserve(uint16_t size, uint16_t *handle, log_level_t level, log_policy_t policy, uint32_t timeout_ms);
+static void log_discard_oldest(uint16_t size, log_level_t level);
+static int log_write_prefix(char *buf, size_t size, uint32_t timestamp, const char *type);
+static void log_report_drops(void);
+#if (1 == LOG_DEFERRED)
+static int log_deferred(const char * format, log_level_t level, log_policy_t policy, uint32_t timeout_ms, va_list va);
+#endif
+static void log_deferred_drain(void);
+#if (1 == LOG_BINARY)
+static void log_binary_write_sync(uint32_t now);
+static void log_binary_write(const log_record_t *record);
+#else
+static void log_deferred_write(const log_record_t *record);
+#endif
+
+/* When set to 1 the next pending TX batch is started from the TX complete
+interrupt, so the line never idles while the writer task waits for the CPU.
+When set to 0 the writer task starts every transfer. */
+#ifndef UART_TX_ISR_CHAINING
+	#define UART_TX_ISR_CHAINING					1
+#endif
+
+/* The DMA writes the received bytes into a circular buffer. The new bytes are
+moved into the stream buffer on the IDLE line, half transfer and transfer
+complete interrupts, so once per burst instead of once per byte. The circular
+buffer must hold the bytes arriving while the interrupts are masked, the stream
+buffer the bytes arriving while the CLI task is busy. */
+#define UART_RX_DMA_BUFFER_SIZE						128
+#define UART_RX_STREAM_BUFFER_SIZE					512
+static uint8_t             uart_rx_dma_buffer[UART_RX_DMA_BUFFER_SIZE];
+static volatile uint16_t   uart_rx_dma_pos			= 0;
+static StaticStreamBuffer_t uart_rx_stream_buffer_struct;
+static uint8_t             uart_rx_stream_buffer_storage[UART_RX_STREAM_BUFFER_SIZE + 1];
+static StreamBufferHandle_t uart_rx_stream_buffer_handle = NULL;
+static uart_rx_stats_t     uart_rx_stats;
+
+#define UART_TX_SPACE_AVAILABLE_BIT					(1UL << 0)
+#define LOG_SPACE_AVAILABLE_BIT						(1UL << 1)
+#define UART_TX_URGENT_SPACE_AVAILABLE_BIT			(1UL << 2)
+static StaticEventGroup_t uart_tx_event_group_storage;
+static EventGroupHandle_t uart_tx_event_group_handle = NULL;
 
 #define UART_WRITE_TASK_PRIORITY					2
 #define UART_WRITE_TASK_STACKSIZE					512
@@ -56,87 +115,561 @@ static TaskHandle_t  uart_write_task_handle			= NULL;
 
 UART_HandleTypeDef huart2;
 DMA_HandleTypeDef  hdma_usart2_tx;
+DMA_HandleTypeDef  hdma_usart2_rx;
 
-static uint8_t uart_tx_buffer[configCOMMAND_INT_MAX_OUTPUT_SIZE*8];
-static uint8_t uart_rx_buffer[4];
+/**
+  * @brief  One priority lane of the UART TX pipeline
+  * @note	done is the descriptor position up to which the messages are
+  * 		transmitted (or discarded), the writer task releases them.
+  * 		commit_ticks holds the commit time of each descriptor for the
+  * 		latency histogram.
+  */
+typedef struct {
+	ring_buffer_t      ring;
+	TickType_t        *commit_ticks;
+	uint16_t           batch_max_size;
+	EventBits_t        space_available_bit;
+	volatile uint16_t  done;
+	uart_tx_latency_t  latency;
+} uart_tx_lane_state_t;
+
+#define UART_TX_BUFFER_SIZE							(configCOMMAND_INT_MAX_OUTPUT_SIZE * 8)
+#define UART_TX_DESCRIPTOR_COUNT					256
+static uint8_t            uart_tx_buffer[UART_TX_BUFFER_SIZE];
+static ring_buffer_desc_t uart_tx_descriptors[UART_TX_DESCRIPTOR_COUNT];
+static TickType_t         uart_tx_commit_ticks[UART_TX_DESCRIPTOR_COUNT];
+
+#define UART_TX_URGENT_BUFFER_SIZE					(configCOMMAND_INT_MAX_OUTPUT_SIZE * 2)
+#define UART_TX_URGENT_DESCRIPTOR_COUNT				32
+static uint8_t            uart_tx_urgent_buffer[UART_TX_URGENT_BUFFER_SIZE];
+static ring_buffer_desc_t uart_tx_urgent_descriptors[UART_TX_URGENT_DESCRIPTOR_COUNT];
+static TickType_t         uart_tx_urgent_commit_ticks[UART_TX_URGENT_DESCRIPTOR_COUNT];
+
+/* The urgent lane is drained first, but a bulk transfer in flight is not
+interrupted. Bulk transfers are kept short so an urgent message waits for at
+most this many bytes (about 45 ms at 115200 baud), or one longer message. */
+#define UART_TX_BULK_BATCH_MAX_SIZE					512
+
+static uart_tx_lane_state_t     uart_tx_lanes[UART_TX_LANE_COUNT];
+static uart_tx_stats_t          uart_tx_stats;
+static volatile bool            uart_tx_dma_busy		= false;
+static volatile uart_tx_lane_t  uart_tx_inflight_lane	= UART_TX_LANE_BULK;
+static volatile uint16_t        uart_tx_inflight_start	= 0;
+static volatile uint16_t        uart_tx_inflight_count	= 0;
+static volatile uint16_t        uart_tx_inflight_end	= 0;
+
+static const char * const log_type_strings[LOG_LEVEL_COUNT] = {
+	[LOG_LEVEL_DEBUG]   = "DEBUG",
+	[LOG_LEVEL_INFO]    = "INFO",
+	[LOG_LEVEL_WARNING] = "WARNING",
+	[LOG_LEVEL_ERROR]   = "ERROR",
+};
+
+/* Dropped messages per level since boot, and the part not reported in-band yet */
+#define LOG_DROP_REPORT_SIZE						160
+static log_drop_stats_t log_drop_stats;
+static log_drop_stats_t log_drop_unreported;
+static volatile bool    log_drop_pending			= false;
+
+/* Log record buffer of the deferred messages. It is used by the log calls
+from interrupts, and with LOG_DEFERRED by the log calls from tasks too. */
+#define LOG_BUFFER_SIZE								2048
+#define LOG_DESCRIPTOR_COUNT						128
+static uint32_t           log_buffer[LOG_BUFFER_SIZE / sizeof(uint32_t)];
+static ring_buffer_desc_t log_descriptors[LOG_DESCRIPTOR_COUNT];
+static ring_buffer_t      log_ring;
+
+#if (1 == LOG_BINARY)
+/* A sync frame is sent before the first record of a batch if the previous
+one is older than this */
+#define LOG_BINARY_SYNC_PERIOD_US					1000000U
+static uint32_t   log_binary_last_timestamp;
+static uint32_t   log_binary_sync_timestamp;
+static bool       log_binary_synced				= false;
+#endif
 
 
 /**
   * @brief  UART writer gatekeeper task
   * @param  params optionally points to data passed on task creation
   * @retval None
-  * @note	Task that performs the UART TX related jobs.
+  * @note	Task that performs the UART TX related jobs. It is notified by
+  * 		the TX complete interrupt and gives the transmitted part of the
+  * 		TX ring buffer back to the producers.
+  * @note	With UART_TX_ISR_CHAINING the transfers are started by the
+  * 		producers and the TX complete interrupt, otherwise this task
+  * 		also starts the next transfer.
+  * @note	This task also formats the captured log records (logged from
+  * 		interrupts or with LOG_DEFERRED) into the TX ring buffer.
+  * @note	Dropped log messages are reported by this task once there is
+  * 		space in the TX ring buffer again.
   */
 static void uart_write_task(void *params)
 {
 	(void)params;
-	BaseType_t ret;
-	HAL_StatusTypeDef hal_status;
-	uint8_t *uart_tx_pending = NULL;
-
-	uart_tx_data_t uart_tx_data = {
-		.pbuf = NULL,
-		.size = 0,
-	};
 
 	for ( ;; )
 	{
-		ret = xQueueReceive(uart_tx_ready_queue_handle, &uart_tx_data, portMAX_DELAY);
-		assert_param(pdPASS == ret);
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+		uart_tx_recycle();
+
+		log_deferred_drain();
+
+		if (true == log_drop_pending) {
+			log_report_drops();
+		}
+	}
+}
+
+/**
+  * @brief  Gives the transmitted part of the TX ring buffer back to the producers
+  * @param  None
+  * @retval None
+  * @note	This function should only be called from the writer task
+  */
+static void uart_tx_recycle(void)
+{
+	for (uint32_t i = 0; i < UART_TX_LANE_COUNT; i++) {
+		uart_tx_lane_state_t * const lane = &uart_tx_lanes[i];
+
+		const uint16_t done = lane->done;
+		if (lane->ring.desc_tail != done) {
+			ring_buffer_release(&lane->ring, done);
+			xEventGroupSetBits(uart_tx_event_group_handle, lane->space_available_bit);
+		}
+	}
+
+#if (0 == UART_TX_ISR_CHAINING)
+	taskENTER_CRITICAL();
+	uart_tx_start_next();
+	taskEXIT_CRITICAL();
+#endif
+}
+
+/**
+  * @brief  Starts a DMA transfer of the pending TX messages if the DMA is idle
+  * @param  None
+  * @retval None
+  * @note	The UART and DMA interrupts must be masked when this function is
+  * 		called (critical section or the TX complete interrupt itself).
+  * @note	Messages that are contiguous in the ring buffer are sent with
+  * 		a single DMA transfer.
+  * @note	The urgent lane is always drained before the bulk lane. Every
+  * 		transfer holds whole messages of a single lane.
+  */
+static void uart_tx_start_next(void)
+{
+	uart_tx_lane_state_t *lane = NULL;
+	uint8_t *pbuf = NULL;
+	uint16_t start = 0;
+	uint16_t size;
+	uint16_t count;
+
+	if (true == uart_tx_dma_busy) {
+		return;
+	}
+
+	for (uint32_t i = 0; (i < UART_TX_LANE_COUNT) && (NULL == pbuf); i++) {
+		lane = &uart_tx_lanes[i];
+
+		start = lane->ring.desc_read;
+		pbuf  = ring_buffer_read(&lane->ring, lane->batch_max_size, &size, &count);
+		while ((NULL != pbuf) && (0 == size)) {
+			/* Only empty messages (see cli_io_commit), nothing to transmit */
+			lane->done = lane->ring.desc_read;
+			start = lane->ring.desc_read;
+			pbuf  = ring_buffer_read(&lane->ring, lane->batch_max_size, &size, &count);
+		}
+
+		if (NULL != pbuf) {
+			uart_tx_inflight_lane = (uart_tx_lane_t)i;
+		}
+	}
+
+	if (NULL == pbuf) {
+		return;
+	}
+
+	uart_tx_dma_busy       = true;
+	uart_tx_inflight_start = start;
+	uart_tx_inflight_count = count;
+	uart_tx_inflight_end   = lane->ring.desc_read;
+
+	HAL_StatusTypeDef hal_status = HAL_UART_Transmit_DMA(&huart2, pbuf, size);
+	assert_param(HAL_OK == hal_status);
+
+	uart_tx_update_stats(size, count);
+}
+
+/**
+  * @brief  Updates the UART TX statistics after starting a DMA transfer
+  * @param  size number of bytes in the transfer
+  * @param  count number of messages in the transfer
+  * @retval None
+  */
+static void uart_tx_update_stats(uint16_t size, uint16_t count)
+{
+	uart_tx_stats.dma_transfers = uart_tx_stats.dma_transfers + 1;
+	uart_tx_stats.messages      = uart_tx_stats.messages + count;
+	uart_tx_stats.bytes         = uart_tx_stats.bytes + size;
+
+	if (count > uart_tx_stats.max_batch_messages) {
+		uart_tx_stats.max_batch_messages = count;
+	}
+
+	if (size > uart_tx_stats.max_batch_bytes) {
+		uart_tx_stats.max_batch_bytes = size;
+	}
+}
+
+/**
+  * @brief  Adds the messages of the completed DMA transfer to the latency
+  * 		histogram of their lane
+  * @param  None
+  * @retval None
+  * @note	This function is called from the TX complete interrupt. The
+  * 		latency of a message is the time from its commit to the end
+  * 		of its transmission.
+  */
+static void uart_tx_update_latency(void)
+{
+	uart_tx_lane_state_t * const lane = &uart_tx_lanes[uart_tx_inflight_lane];
+	const TickType_t now = xTaskGetTickCountFromISR();
+
+	for (uint16_t i = 0; i < uart_tx_inflight_count; i++) {
+		const uint16_t desc = (uint16_t)(uart_tx_inflight_start + i);
+		const uint32_t latency_ms = ((uint32_t)(now - lane->commit_ticks[desc & (lane->ring.desc_count - 1U)]) * 1000U) / configTICK_RATE_HZ;
+
+		uint32_t bucket = 32U - __CLZ(latency_ms);
+		if (bucket >= UART_TX_LATENCY_BUCKETS) {
+			bucket = UART_TX_LATENCY_BUCKETS - 1U;
+		}
+
+		lane->latency.buckets[bucket] = lane->latency.buckets[bucket] + 1;
+		if (latency_ms > lane->latency.max_ms) {
+			lane->latency.max_ms = latency_ms;
+		}
+	}
+}
+
+/**
+  * @brief  Reserves space in a ring buffer, waiting for free space if needed
+  * @param  rb points to the ring buffer
+  * @param  size number of bytes to be reserved
+  * @param  handle points where the handle of the reservation can be stored
+  * @param  space_available_bit event bit set by the writer task after releasing
+  * 		space in the ring buffer
+  * @param  ticks_to_wait maximum time to wait for free space, portMAX_DELAY
+  * 		to wait forever
+  * @retval pointer to the reserved region, NULL if the wait timed out
+  * @note	This function might cause the calling task to go to the blocked state
+  * 		if there is not enough free space in the ring buffer
+  */
+static uint8_t *uart_ring_reserve(ring_buffer_t *rb, uint16_t size, uint16_t *handle, EventBits_t space_available_bit, TickType_t ticks_to_wait)
+{
+	TimeOut_t timeout;
+	uint8_t *pbuf;
+
+	vTaskSetTimeOutState(&timeout);
+
+	while (NULL == (pbuf = ring_buffer_reserve(rb, size, handle))) {
+		/* Clear before retrying so a release between the retry and the wait is not missed */
+		xEventGroupClearBits(uart_tx_event_group_handle, space_available_bit);
+
+		pbuf = ring_buffer_reserve(rb, size, handle);
+		if (NULL != pbuf) {
+			break;
+		}
+
+		if (pdTRUE == xTaskCheckForTimeOut(&timeout, &ticks_to_wait)) {
+			break;
+		}
+
+		xEventGroupWaitBits(uart_tx_event_group_handle, space_available_bit, pdFALSE, pdFALSE, ticks_to_wait);
+	}
+
+	return pbuf;
+}
+
+/**
+  * @brief  Reserves space for a message in the UART TX ring buffer of a lane
+  * @param  lane the message is sent on
+  * @param  size maximum size of the message
+  * @param  handle points where the handle of the reservation can be stored
+  * @retval pointer to the reserved region
+  * @note	This function might cause the calling task to go to the blocked state
+  * 		if there is not enough free space in the ring buffer
+  * @note	The writer task waits for its own TX complete notifications
+  * 		instead of the event group, since it is the one releasing space.
+  */
+static uint8_t *uart_tx_reserve(uart_tx_lane_t lane, uint16_t size, uint16_t *handle)
+{
+	ring_buffer_t * const rb = &uart_tx_lanes[lane].ring;
+	uint8_t *pbuf;
+
+	if (xTaskGetCurrentTaskHandle() != uart_write_task_handle) {
+		return uart_ring_reserve(rb, size, handle, uart_tx_lanes[lane].space_available_bit, portMAX_DELAY);
+	}
+
+	while (NULL == (pbuf = ring_buffer_reserve(rb, size, handle))) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		uart_tx_recycle();
+	}
+
+	return pbuf;
+}
+
+/**
+  * @brief  Commits a message to the UART TX ring buffer of a lane
+  * @param  lane the message was reserved on
+  * @param  handle of the reservation returned by uart_tx_reserve
+  * @param  size of the message
+  * @retval None
+  */
+static void uart_tx_commit(uart_tx_lane_t lane, uint16_t handle, uint16_t size)
+{
+	uart_tx_lane_state_t * const state = &uart_tx_lanes[lane];
+
+	state->commit_ticks[handle & (state->ring.desc_count - 1U)] = xTaskGetTickCount();
+	ring_buffer_commit(&state->ring, handle, size);
+
+#if (1 == UART_TX_ISR_CHAINING)
+	/* If the DMA is busy the TX complete interrupt picks the message up */
+	if (false == uart_tx_dma_busy) {
+		taskENTER_CRITICAL();
+		uart_tx_start_next();
+		taskEXIT_CRITICAL();
+	}
+#else
+	xTaskNotifyGive(uart_write_task_handle);
+#endif
+}
+
+/**
+  * @brief  Gets the UART TX lane of the log messages of a level
+  * @param  level of the message
+  * @retval UART_TX_LANE_URGENT for errors, UART_TX_LANE_BULK otherwise
+  * @note	With LOG_BINARY every frame is sent on the bulk lane, since the
+  * 		timestamp of a frame is relative to the previous one.
+  */
+static uart_tx_lane_t log_lane(log_level_t level)
+{
+#if (1 == LOG_BINARY)
+	(void)level;
+	return UART_TX_LANE_BULK;
+#else
+	return (LOG_LEVEL_ERROR == level) ? UART_TX_LANE_URGENT : UART_TX_LANE_BULK;
+#endif
+}
+
+/**
+  * @brief  Reserves space for a log message according to a drop policy
+  * @param  size maximum size of the message
+  * @param  handle points where the handle of the reservation can be stored
+  * @param  level of the message, used for the drop counters
+  * @param  policy what to do if the log buffer is full, see log_policy_t
+  * @param  timeout_ms maximum wait for LOG_POLICY_TIMEOUT and LOG_POLICY_OVERWRITE_OLDEST
+  * @retval pointer to the reserved region, NULL if the message was dropped
+  * @note	The log buffer is the log record buffer with LOG_DEFERRED and
+  * 		the TX ring buffer of the lane of the level otherwise
+  */
+static uint8_t *log_reserve(uint16_t size, uint16_t *handle, log_level_t level, log_policy_t policy, uint32_t timeout_ms)
+{
+#if (1 == LOG_DEFERRED)
+	ring_buffer_t * const rb  = &log_ring;
+	const EventBits_t     bit = LOG_SPACE_AVAILABLE_BIT;
+#else
+	ring_buffer_t * const rb  = &uart_tx_lanes[log_lane(level)].ring;
+	const EventBits_t     bit = uart_tx_lanes[log_lane(level)].space_available_bit;
+#endif
+
+	uint8_t *pbuf = ring_buffer_reserve(rb, size, handle);
+	if (NULL != pbuf) {
+		return pbuf;
+	}
+
+	switch (policy) {
+	case LOG_POLICY_BLOCK:
+		pbuf = uart_ring_reserve(rb, size, handle, bit, portMAX_DELAY);
+		break;
+
+	case LOG_POLICY_TIMEOUT:
+		pbuf = uart_ring_reserve(rb, size, handle, bit, pdMS_TO_TICKS(timeout_ms));
+		break;
 
-		hal_status = HAL_UART_Transmit_DMA(&huart2, uart_tx_data.pbuf, uart_tx_data.size);
-		assert_param(HAL_OK == hal_status);
-		uart_tx_pending = uart_tx_data.pbuf;
+	case LOG_POLICY_OVERWRITE_OLDEST:
+		log_discard_oldest(size, level);
+		pbuf = uart_ring_reserve(rb, size, handle, bit, pdMS_TO_TICKS(timeout_ms));
+		break;
 
-		ret = xSemaphoreTake(uart_tx_complete_semaphore_handle, portMAX_DELAY);
-		assert_param(pdPASS == ret);
+	default:
+		break;
+	}
+
+	if (NULL == pbuf) {
+		taskENTER_CRITICAL();
+		log_drop_stats.dropped[level]      = log_drop_stats.dropped[level] + 1;
+		log_drop_unreported.dropped[level] = log_drop_unreported.dropped[level] + 1;
+		log_drop_pending                   = true;
+		taskEXIT_CRITICAL();
+	}
+
+	return pbuf;
+}
+
+/**
+  * @brief  Discards the oldest log messages that are not being transmitted yet
+  * @param  size number of bytes to be freed
+  * @param  level of the message that needs the space, selects the TX lane
+  * @retval None
+  * @note	The space of the discarded messages is given back by the writer
+  * 		task. In the TX ring buffer that happens once the transfer in
+  * 		flight is complete, the discarded messages are released with it.
+  */
+static void log_discard_oldest(uint16_t size, log_level_t level)
+{
+	uint16_t n;
+
+	taskENTER_CRITICAL();
+
+#if (1 == LOG_DEFERRED)
+	(void)level;
+	n = ring_buffer_skip(&log_ring, size);
+#else
+	const uart_tx_lane_t lane = log_lane(level);
+	n = ring_buffer_skip(&uart_tx_lanes[lane].ring, size);
+
+	if (0 != n) {
+		if ((true == uart_tx_dma_busy) && (lane == uart_tx_inflight_lane)) {
+			uart_tx_inflight_end = uart_tx_lanes[lane].ring.desc_read;
+		} else {
+			uart_tx_lanes[lane].done = uart_tx_lanes[lane].ring.desc_read;
+		}
+	}
+#endif
+
+	if (0 != n) {
+		log_drop_stats.overwritten      = log_drop_stats.overwritten + n;
+		log_drop_unreported.overwritten = log_drop_unreported.overwritten + n;
+		log_drop_pending                = true;
+	}
+
+	taskEXIT_CRITICAL();
+
+	if (0 != n) {
+		xTaskNotifyGive(uart_write_task_handle);
+	}
+}
+
+/**
+  * @brief  Writes the [hh:mm:ss] or [hh:mm:ss.uuuuuu] prefix of a text log message
+  * @param  buf points where the prefix can be written
+  * @param  size of buf
+  * @param  timestamp of the message, see timestamp_get
+  * @param  type string of the message level
+  * @retval length of the prefix without the terminating null character
+  */
+static int log_write_prefix(char *buf, size_t size, uint32_t timestamp, const char *type)
+{
+	uint32_t seconds;
+	uint32_t microseconds;
+
+	timestamp_to_time_of_day(timestamp, &seconds, &microseconds);
+
+#if (1 == LOG_TIMESTAMP_US)
+	int len = snprintf(buf, size, "[%02lu:%02lu:%02lu.%06lu] %s: ", seconds / 3600U, (seconds / 60U) % 60U, seconds % 60U, microseconds, type);
+#else
+	(void)microseconds;
+	int len = snprintf(buf, size, "[%02lu:%02lu:%02lu] %s: ", seconds / 3600U, (seconds / 60U) % 60U, seconds % 60U, type);
+#endif
+	assert_param(len < (int)size);
+
+	return len;
+}
+
+/**
+  * @brief  Reports the dropped log messages in-band
+  * @param  None
+  * @retval None
+  * @note	This function should only be called from the writer task. If
+  * 		there is no space for the report it is retried on the next wake-up.
+  */
+static void log_report_drops(void)
+{
+	log_drop_stats_t drops;
+	uint16_t handle;
 
-		ret = xQueueSend(uart_tx_available_queue_handle, &uart_tx_pending, 0);
-		assert_param(pdPASS == ret);
+	uint8_t *pbuf = ring_buffer_reserve(&uart_tx_lanes[UART_TX_LANE_BULK].ring, LOG_DROP_REPORT_SIZE, &handle);
+	if (NULL == pbuf) {
+		return;
 	}
+
+	taskENTER_CRITICAL();
+	drops = log_drop_unreported;
+	memset(&log_drop_unreported, 0, sizeof(log_drop_unreported));
+	log_drop_pending = false;
+	taskEXIT_CRITICAL();
+
+	int len = log_write_prefix((char *)pbuf, LOG_DROP_REPORT_SIZE, timestamp_get(), log_type_strings[LOG_LEVEL_WARNING]);
+	len = len + snprintf((char *)(pbuf + len), LOG_DROP_REPORT_SIZE - len, "%lu messages dropped (%s %lu, %s %lu, %s %lu, %s %lu), %lu overwritten\r\n",
+			drops.dropped[LOG_LEVEL_DEBUG] + drops.dropped[LOG_LEVEL_INFO] + drops.dropped[LOG_LEVEL_WARNING] + drops.dropped[LOG_LEVEL_ERROR],
+			log_type_strings[LOG_LEVEL_DEBUG],   drops.dropped[LOG_LEVEL_DEBUG],
+			log_type_strings[LOG_LEVEL_INFO],    drops.dropped[LOG_LEVEL_INFO],
+			log_type_strings[LOG_LEVEL_WARNING], drops.dropped[LOG_LEVEL_WARNING],
+			log_type_strings[LOG_LEVEL_ERROR],   drops.dropped[LOG_LEVEL_ERROR],
+			drops.overwritten);
+	if (len >= LOG_DROP_REPORT_SIZE) {
+		len = LOG_DROP_REPORT_SIZE - 1;
+	}
+
+	uart_tx_commit(UART_TX_LANE_BULK, handle, (uint16_t)len);
 }
 
 /**
   * @brief  Initializes the Log and CLI I/O
   * @param  None
   * @retval None
-  * @note	This function initializes the UART2 and RTC peripherals,
-  * 		and creates the Log and CLI I/O related tasks, queues and semaphores
+  * @note	This function initializes the UART2 and RTC peripherals and the
+  * 		timestamp service, and creates the Log and CLI I/O related tasks,
+  * 		queues and event groups
   */
 void log_and_cli_io_init(void)
 {
 	RTC_Init();
+	timestamp_init();
 	UART2_Init();
 
-	uart_tx_complete_semaphore_handle = xSemaphoreCreateBinaryStatic(&uart_tx_complete_semaphore_storage);
-	assert_param(NULL != uart_tx_complete_semaphore_handle);
-	xSemaphoreTake(uart_tx_complete_semaphore_handle, 0);
-
-	uart_tx_available_queue_handle    = xQueueCreateStatic(
-										UART_TX_AVAILABLE_QUEUE_LENGTH,
-										sizeof(uint8_t *),
-										uart_tx_available_queue_storage,
-										&uart_tx_available_struct);
-	assert_param(NULL != uart_tx_available_queue_handle);
-
-	uart_tx_ready_queue_handle        = xQueueCreateStatic(
-										UART_TX_READY_QUEUE_LENGTH,
-										sizeof(uart_tx_data_t),
-										uart_tx_ready_queue_storage,
-										&uart_tx_ready_struct);
-	assert_param(NULL != uart_tx_ready_queue_handle);
-
-	uart_rx_queue_handle			  = xQueueCreateStatic(
-										UART_RX_QUEUE_LENGTH,
-										sizeof(uint8_t),
-										uart_rx_queue_storage,
-										&uart_rx_queue_struct);
-	assert_param(NULL != uart_rx_queue_handle);
-
-	for (uint8_t i = 0; i < 8; i++) {
-		uint8_t *buffer_address = &uart_tx_buffer[i*configCOMMAND_INT_MAX_OUTPUT_SIZE];
-		xQueueSend(uart_tx_available_queue_handle, &buffer_address, 0);
-	}
+	uart_tx_event_group_handle        = xEventGroupCreateStatic(&uart_tx_event_group_storage);
+	assert_param(NULL != uart_tx_event_group_handle);
+
+	memset(uart_tx_lanes, 0, sizeof(uart_tx_lanes));
+	ring_buffer_init(&uart_tx_lanes[UART_TX_LANE_URGENT].ring, uart_tx_urgent_buffer, UART_TX_URGENT_BUFFER_SIZE, uart_tx_urgent_descriptors, UART_TX_URGENT_DESCRIPTOR_COUNT);
+	uart_tx_lanes[UART_TX_LANE_URGENT].commit_ticks        = uart_tx_urgent_commit_ticks;
+	uart_tx_lanes[UART_TX_LANE_URGENT].batch_max_size      = UART_TX_URGENT_BUFFER_SIZE;
+	uart_tx_lanes[UART_TX_LANE_URGENT].space_available_bit = UART_TX_URGENT_SPACE_AVAILABLE_BIT;
+	ring_buffer_init(&uart_tx_lanes[UART_TX_LANE_BULK].ring, uart_tx_buffer, UART_TX_BUFFER_SIZE, uart_tx_descriptors, UART_TX_DESCRIPTOR_COUNT);
+	uart_tx_lanes[UART_TX_LANE_BULK].commit_ticks          = uart_tx_commit_ticks;
+	uart_tx_lanes[UART_TX_LANE_BULK].batch_max_size        = UART_TX_BULK_BATCH_MAX_SIZE;
+	uart_tx_lanes[UART_TX_LANE_BULK].space_available_bit   = UART_TX_SPACE_AVAILABLE_BIT;
+	ring_buffer_init(&log_ring, (uint8_t *)log_buffer, LOG_BUFFER_SIZE, log_descriptors, LOG_DESCRIPTOR_COUNT);
+	memset(&uart_tx_stats, 0, sizeof(uart_tx_stats));
+	memset(&log_drop_stats, 0, sizeof(log_drop_stats));
+	memset(&log_drop_unreported, 0, sizeof(log_drop_unreported));
+	log_drop_pending     = false;
+	uart_tx_dma_busy       = false;
+	uart_tx_inflight_lane  = UART_TX_LANE_BULK;
+	uart_tx_inflight_start = 0;
+	uart_tx_inflight_count = 0;
+	uart_tx_inflight_end   = 0;
+
+	uart_rx_stream_buffer_handle	  = xStreamBufferCreateStatic(
+										UART_RX_STREAM_BUFFER_SIZE,
+										1,
+										uart_rx_stream_buffer_storage,
+										&uart_rx_stream_buffer_struct);
+	assert_param(NULL != uart_rx_stream_buffer_handle);
+	memset(&uart_rx_stats, 0, sizeof(uart_rx_stats));
 
 	uart_write_task_handle 			  = xTaskCreateStatic(
 										uart_write_task,
@@ -149,27 +682,26 @@ void log_and_cli_io_init(void)
 
 	assert_param(NULL != uart_write_task_handle);
 
-	HAL_StatusTypeDef hal_status = HAL_UART_Receive_IT(&huart2, &uart_rx_buffer[0], 1);
-	assert_param(HAL_OK == hal_status);
+	uart_rx_start();
 }
 
 /**
   * @brief  Deinitializes the Log and CLI I/O
   * @param  None
   * @retval None
-  * @note	This function deinitializes the UART2 and RTC peripherals,
-  * 		and deletes the Log and CLI I/O related tasks, queues and semaphores
+  * @note	This function deinitializes the UART2 and RTC peripherals and the
+  * 		timestamp service, and deletes the Log and CLI I/O related tasks,
+  * 		queues and event groups
   */
 void log_and_cli_io_deinit(void)
 {
 	UART2_Deinit();
+	timestamp_deinit();
 	RTC_Deinit();
 
 	vTaskDelete(uart_write_task_handle);
-	vQueueDelete(uart_tx_available_queue_handle);
-	vQueueDelete(uart_tx_ready_queue_handle);
-	vQueueDelete(uart_rx_queue_handle);
-	vSemaphoreDelete(uart_tx_complete_semaphore_handle);
+	vEventGroupDelete(uart_tx_event_group_handle);
+	vStreamBufferDelete(uart_rx_stream_buffer_handle);
 }
 
 /**
@@ -204,7 +736,10 @@ static void UART2_Init(void)
 	ret = HAL_UART_RegisterCallback(&huart2, HAL_UART_TX_COMPLETE_CB_ID, UART2_TxCpltCallback);
 	assert_param(HAL_OK == ret);
 
-	ret = HAL_UART_RegisterCallback(&huart2, HAL_UART_RX_COMPLETE_CB_ID, UART2_RxCpltCallback);
+	ret = HAL_UART_RegisterRxEventCallback(&huart2, UART2_RxEventCallback);
+	assert_param(HAL_OK == ret);
+
+	ret = HAL_UART_RegisterCallback(&huart2, HAL_UART_ERROR_CB_ID, UART2_ErrorCallback);
 	assert_param(HAL_OK == ret);
 }
 
@@ -256,6 +791,23 @@ static void UART2_MspInit(UART_HandleTypeDef* huart)
 
 	__HAL_LINKDMA(huart, hdmatx, hdma_usart2_tx);
 
+	/* USART2_RX Init */
+	hdma_usart2_rx.Instance                 = DMA1_Stream5;
+	hdma_usart2_rx.Init.Channel             = DMA_CHANNEL_4;
+	hdma_usart2_rx.Init.Direction           = DMA_PERIPH_TO_MEMORY;
+	hdma_usart2_rx.Init.PeriphInc           = DMA_PINC_DISABLE;
+	hdma_usart2_rx.Init.MemInc              = DMA_MINC_ENABLE;
+	hdma_usart2_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	hdma_usart2_rx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+	hdma_usart2_rx.Init.Mode                = DMA_CIRCULAR;
+	hdma_usart2_rx.Init.Priority            = DMA_PRIORITY_LOW;
+	hdma_usart2_rx.Init.FIFOMode            = DMA_FIFOMODE_DISABLE;
+
+	ret = HAL_DMA_Init(&hdma_usart2_rx);
+	assert_param(HAL_OK == ret);
+
+	__HAL_LINKDMA(huart, hdmarx, hdma_usart2_rx);
+
 	/* USART2 interrupt Init */
 	HAL_NVIC_SetPriority(USART2_IRQn, 14, 0);
 	HAL_NVIC_EnableIRQ(USART2_IRQn);
@@ -264,6 +816,10 @@ static void UART2_MspInit(UART_HandleTypeDef* huart)
 	/* DMA1_Stream6_IRQn interrupt configuration */
 	HAL_NVIC_SetPriority(DMA1_Stream6_IRQn, 14, 0);
 	HAL_NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+
+	/* DMA1_Stream5_IRQn interrupt configuration */
+	HAL_NVIC_SetPriority(DMA1_Stream5_IRQn, 14, 0);
+	HAL_NVIC_EnableIRQ(DMA1_Stream5_IRQn);
 }
 
 /**
@@ -313,10 +869,12 @@ static void UART2_MspDeInit(UART_HandleTypeDef* huart)
 
 	/* USART2 DMA DeInit */
 	HAL_DMA_DeInit(huart->hdmatx);
+	HAL_DMA_DeInit(huart->hdmarx);
 
 	/* USART2 interrupt Deinit */
 	HAL_NVIC_DisableIRQ(USART2_IRQn);
 	HAL_NVIC_DisableIRQ(DMA1_Stream6_IRQn);
+	HAL_NVIC_DisableIRQ(DMA1_Stream5_IRQn);
 }
 
 /**
@@ -325,109 +883,476 @@ static void UART2_MspDeInit(UART_HandleTypeDef* huart)
   * @retval None
   * @note	This function is called by the HAL library
   * 		when the DMA1 is finished transferring data
+  * @note	With UART_TX_ISR_CHAINING the next pending batch is started
+  * 		right here, the writer task is only notified to recycle the
+  * 		transmitted part of the TX ring buffer.
   */
 static void UART2_TxCpltCallback(UART_HandleTypeDef *huart)
 {
 	portBASE_TYPE higher_priority_task_woken = pdFALSE;
-	xSemaphoreGiveFromISR(uart_tx_complete_semaphore_handle, &higher_priority_task_woken);
+
+	uart_tx_update_latency();
+
+	uart_tx_lanes[uart_tx_inflight_lane].done = uart_tx_inflight_end;
+	uart_tx_dma_busy = false;
+
+#if (1 == UART_TX_ISR_CHAINING)
+	uart_tx_start_next();
+#endif
+
+	vTaskNotifyGiveFromISR(uart_write_task_handle, &higher_priority_task_woken);
 	portYIELD_FROM_ISR(higher_priority_task_woken);
 }
 
 /**
-  * @brief  UART2 Receive complete callback
+  * @brief  Starts the circular DMA reception with IDLE line detection
+  * @param  None
+  * @retval None
+  */
+static void uart_rx_start(void)
+{
+	uart_rx_dma_pos = 0;
+
+	HAL_StatusTypeDef hal_status = HAL_UARTEx_ReceiveToIdle_DMA(&huart2, uart_rx_dma_buffer, UART_RX_DMA_BUFFER_SIZE);
+	assert_param(HAL_OK == hal_status);
+}
+
+/**
+  * @brief  UART2 Reception event callback
   * @param  huart
+  * @param  pos position in the circular DMA buffer up to which the bytes are received
   * @retval None
-  * @note	This function is called by the HAL library
-  * 		when a character is arrived.
+  * @note	This function is called by the HAL library on the IDLE line,
+  * 		the DMA half transfer and the DMA transfer complete interrupts.
+  * 		The bytes received since the previous call are moved into the
+  * 		stream buffer, the ones that do not fit are counted and dropped.
   */
-static void UART2_RxCpltCallback(UART_HandleTypeDef *huart)
+static void UART2_RxEventCallback(UART_HandleTypeDef *huart, uint16_t pos)
 {
 	portBASE_TYPE higher_priority_task_woken = pdFALSE;
-	xQueueSendFromISR(uart_rx_queue_handle, &uart_rx_buffer[0], &higher_priority_task_woken);
-	HAL_UART_Receive_IT(&huart2, &uart_rx_buffer[0], 1);
+	size_t received = 0;
+	size_t sent     = 0;
+
+	if (pos != uart_rx_dma_pos) {
+		if (pos > uart_rx_dma_pos) {
+			received = (size_t)(pos - uart_rx_dma_pos);
+			sent     = xStreamBufferSendFromISR(uart_rx_stream_buffer_handle, &uart_rx_dma_buffer[uart_rx_dma_pos], received, &higher_priority_task_woken);
+		} else {
+			/* The DMA wrapped around since the previous call */
+			received = (size_t)(UART_RX_DMA_BUFFER_SIZE - uart_rx_dma_pos) + pos;
+			sent     = xStreamBufferSendFromISR(uart_rx_stream_buffer_handle, &uart_rx_dma_buffer[uart_rx_dma_pos], UART_RX_DMA_BUFFER_SIZE - uart_rx_dma_pos, &higher_priority_task_woken);
+			sent     = sent + xStreamBufferSendFromISR(uart_rx_stream_buffer_handle, &uart_rx_dma_buffer[0], pos, &higher_priority_task_woken);
+		}
+
+		uart_rx_dma_pos = pos;
+	}
+
+	if (UART_RX_DMA_BUFFER_SIZE == uart_rx_dma_pos) {
+		uart_rx_dma_pos = 0;
+	}
+
+	uart_rx_stats.events        = uart_rx_stats.events + 1;
+	uart_rx_stats.bytes         = uart_rx_stats.bytes + received;
+	uart_rx_stats.dropped_bytes = uart_rx_stats.dropped_bytes + (received - sent);
+
 	portYIELD_FROM_ISR(higher_priority_task_woken);
 }
 
 /**
-  * @brief  Low-level log function (used by log_info, log_warning and log_error)
+  * @brief  UART2 Error callback
+  * @param  huart
+  * @retval None
+  * @note	This function is called by the HAL library. A reception error
+  * 		(overrun, framing, noise, parity) aborts the DMA reception, it
+  * 		is restarted here.
+  */
+static void UART2_ErrorCallback(UART_HandleTypeDef *huart)
+{
+	uart_rx_stats.errors = uart_rx_stats.errors + 1;
+
+	if (HAL_UART_STATE_READY == huart->RxState) {
+		uart_rx_start();
+	}
+}
+
+/**
+  * @brief  Low-level log function (used by log_debug, log_info, log_warning and log_error)
   * @param  format, string with optional formatspecifiers
-  * @param	type, string defines the log type (INFO, WARNING, ERROR)
+  * @param	level, of the message (DEBUG, INFO, WARNING, ERROR)
+  * @param  policy, what to do if the log buffer is full, see log_policy_t
+  * @param  timeout_ms, maximum wait for LOG_POLICY_TIMEOUT and LOG_POLICY_OVERWRITE_OLDEST
   * @param  va, list containing arguments defined by format
-  * @retval len, total length of the log message string
-  * @note	This function might cause the calling task to go to the blocked state
-  * 		if there is no free space in the queue
+  * @retval len, total length of the log message string, -1 if the message was dropped
+  * @note	Depending on the policy this function might cause the calling task
+  * 		to go to the blocked state if there is no free space in the TX ring buffer
+  * @note	The message is formatted directly into the TX ring buffer, the
+  * 		unused part of the reservation is given back on commit
+  * @note	With LOG_DEFERRED the message is only captured and 0 is returned,
+  * 		see log_deferred
+  */
+int log_(const char * format, log_level_t level, log_policy_t policy, uint32_t timeout_ms, va_list va)
+{
+#if (1 == LOG_DEFERRED)
+	return log_deferred(format, level, policy, timeout_ms, va);
+#else
+	const uint32_t now = timestamp_get();
+	uint16_t handle;
+
+	uint8_t *pbuf = log_reserve(configCOMMAND_INT_MAX_OUTPUT_SIZE, &handle, level, policy, timeout_ms);
+	if (NULL == pbuf) {
+		return -1;
+	}
+
+	int len = log_write_prefix((char *)pbuf, configCOMMAND_INT_MAX_OUTPUT_SIZE, now, log_type_strings[level]);
+
+	len = len + vsnprintf((char *)(pbuf + len), configCOMMAND_INT_MAX_OUTPUT_SIZE - len, format, va);
+	if (len >= configCOMMAND_INT_MAX_OUTPUT_SIZE) {
+		/* The message was truncated, the terminating null character is not transmitted */
+		len = configCOMMAND_INT_MAX_OUTPUT_SIZE - 1;
+	}
+
+	uart_tx_commit(log_lane(level), handle, (uint16_t)len);
+
+	return len;
+#endif
+}
+
+#if (1 == LOG_DEFERRED)
+/**
+  * @brief  Captures a log message into the log record buffer
+  * @param  format, string with optional formatspecifiers
+  * @param	level, of the message (DEBUG, INFO, WARNING, ERROR)
+  * @param  policy, what to do if the log buffer is full, see log_policy_t
+  * @param  timeout_ms, maximum wait for LOG_POLICY_TIMEOUT and LOG_POLICY_OVERWRITE_OLDEST
+  * @param  va, list containing arguments defined by format
+  * @retval 0, the message is formatted later by the writer task, -1 if it was dropped
+  * @note	Only the timestamp, the format and type addresses and the raw
+  * 		argument words are stored, the format string is scanned for
+  * 		the argument types but not formatted.
+  * @note	Depending on the policy this function might cause the calling task
+  * 		to go to the blocked state if there is no free space in the log record buffer
   */
-int log_(const char * format, const char * type, va_list va)
+static int log_deferred(const char * format, log_level_t level, log_policy_t policy, uint32_t timeout_ms, va_list va)
 {
-	uint8_t hours;
-	uint8_t minutes;
-	uint8_t seconds;
+	uint16_t handle;
+
+	log_record_t *record = (log_record_t *)log_reserve(LOG_RECORD_SIZE(LOG_RECORD_MAX_ARGS), &handle, level, policy, timeout_ms);
+	if (NULL == record) {
+		return -1;
+	}
 
-	uart_tx_data_t data = {
-		.pbuf = NULL,
-		.size = 0,
-	};
+	record->timestamp = timestamp_get();
+	record->format    = format;
+	record->type      = log_type_strings[level];
+	record->arg_count = log_record_capture(format, va, record->args, LOG_RECORD_MAX_ARGS);
 
-	BaseType_t ret;
+	ring_buffer_commit(&log_ring, handle, LOG_RECORD_SIZE(record->arg_count));
+	xTaskNotifyGive(uart_write_task_handle);
+
+	return 0;
+}
+#endif
+
+/**
+  * @brief  Low-level log function for interrupts (used by log_debug_from_isr,
+  * 		log_info_from_isr, log_warning_from_isr and log_error_from_isr)
+  * @param  format, string with optional formatspecifiers
+  * @param	level, of the message (DEBUG, INFO, WARNING, ERROR)
+  * @param  va, list containing arguments defined by format
+  * @retval 0, the message is formatted later by the writer task, -1 if it was dropped
+  * @note	The message is captured into the log record buffer like with
+  * 		LOG_DEFERRED, see log_deferred. The reservation is lock-free,
+  * 		the message is dropped if the buffer is full.
+  * @note	The priority of the calling interrupt must be lower (numerically
+  * 		higher) than configMAX_SYSCALL_INTERRUPT_PRIORITY.
+  */
+int log_from_isr_(const char * format, log_level_t level, va_list va)
+{
+	portBASE_TYPE higher_priority_task_woken = pdFALSE;
+	uint16_t handle;
+
+	log_record_t *record = (log_record_t *)ring_buffer_reserve(&log_ring, LOG_RECORD_SIZE(LOG_RECORD_MAX_ARGS), &handle);
+	if (NULL == record) {
+		const UBaseType_t saved_interrupt_status = taskENTER_CRITICAL_FROM_ISR();
+		log_drop_stats.dropped[level]      = log_drop_stats.dropped[level] + 1;
+		log_drop_unreported.dropped[level] = log_drop_unreported.dropped[level] + 1;
+		log_drop_pending                   = true;
+		taskEXIT_CRITICAL_FROM_ISR(saved_interrupt_status);
+		return -1;
+	}
 
-	ret = xQueueReceive(uart_tx_available_queue_handle, &data.pbuf, portMAX_DELAY);
-	assert_param( pdTRUE == ret);
+	record->timestamp = timestamp_get();
+	record->format    = format;
+	record->type      = log_type_strings[level];
+	record->arg_count = log_record_capture(format, va, record->args, LOG_RECORD_MAX_ARGS);
 
-	RTC_GetTime(&hours, &minutes, &seconds);
+	ring_buffer_commit(&log_ring, handle, LOG_RECORD_SIZE(record->arg_count));
 
-	int len = snprintf((char *)data.pbuf, configCOMMAND_INT_MAX_OUTPUT_SIZE, "[%02d:%02d:%02d] %s: ", hours, minutes, seconds, type);
-	assert_param(len < configCOMMAND_INT_MAX_OUTPUT_SIZE);
+	vTaskNotifyGiveFromISR(uart_write_task_handle, &higher_priority_task_woken);
+	portYIELD_FROM_ISR(higher_priority_task_woken);
 
-	data.size = (uint8_t)len + (uint8_t)vsnprintf((char *)(data.pbuf+len), configCOMMAND_INT_MAX_OUTPUT_SIZE-len, format, va);
-	assert_param(data.size <= configCOMMAND_INT_MAX_OUTPUT_SIZE);
+	return 0;
+}
 
-	ret = xQueueSend(uart_tx_ready_queue_handle, &data, portMAX_DELAY);
-	assert_param(pdTRUE == ret);
+/**
+  * @brief  Formats the captured log records into the UART TX ring buffer
+  * @param  None
+  * @retval None
+  * @note	This function should only be called from the writer task.
+  * @note	With LOG_BINARY the records are sent as binary frames, the
+  * 		wall-clock time is sent in a sync frame at most once per
+  * 		LOG_BINARY_SYNC_PERIOD_US.
+  */
+static void log_deferred_drain(void)
+{
+	uint8_t *pbuf;
+	uint16_t size;
+	uint16_t count;
+
+	for ( ;; ) {
+		/* Producers discarding the oldest records move the read position too */
+		taskENTER_CRITICAL();
+		pbuf = ring_buffer_read(&log_ring, LOG_BUFFER_SIZE, &size, &count);
+		taskEXIT_CRITICAL();
+
+		if (NULL == pbuf) {
+			break;
+		}
+
+#if (1 == LOG_BINARY)
+		const uint32_t now = timestamp_get();
+		if ((false == log_binary_synced) || ((now - log_binary_sync_timestamp) >= LOG_BINARY_SYNC_PERIOD_US)) {
+			log_binary_write_sync(now);
+		}
+#endif
+
+		for (uint16_t i = 0; i < count; i++) {
+			const log_record_t *record = (const log_record_t *)pbuf;
+#if (1 == LOG_BINARY)
+			log_binary_write(record);
+#else
+			log_deferred_write(record);
+#endif
+			pbuf = pbuf + LOG_RECORD_SIZE(record->arg_count);
+		}
+
+		ring_buffer_release(&log_ring, log_ring.desc_read);
+		xEventGroupSetBits(uart_tx_event_group_handle, LOG_SPACE_AVAILABLE_BIT);
+	}
 
-	return (int)data.size;
+	/* Records discarded by LOG_POLICY_OVERWRITE_OLDEST */
+	if (log_ring.desc_tail != log_ring.desc_read) {
+		ring_buffer_release(&log_ring, log_ring.desc_read);
+		xEventGroupSetBits(uart_tx_event_group_handle, LOG_SPACE_AVAILABLE_BIT);
+	}
 }
 
+#if (0 == LOG_BINARY)
 /**
-  * @brief  Reads one byte from the UART RX queue
-  * @param  ch the byte read from the queue
+  * @brief  Formats one captured log record into the UART TX ring buffer
+  * @param  record points to the log record
+  * @retval None
+  */
+static void log_deferred_write(const log_record_t *record)
+{
+	const uart_tx_lane_t lane = (log_type_strings[LOG_LEVEL_ERROR] == record->type) ? UART_TX_LANE_URGENT : UART_TX_LANE_BULK;
+	uint16_t handle;
+
+	uint8_t *pbuf = uart_tx_reserve(lane, configCOMMAND_INT_MAX_OUTPUT_SIZE, &handle);
+
+	int len = log_write_prefix((char *)pbuf, configCOMMAND_INT_MAX_OUTPUT_SIZE, record->timestamp, record->type);
+
+	len = len + log_record_format((char *)(pbuf + len), configCOMMAND_INT_MAX_OUTPUT_SIZE - len, record->format, record->args, record->arg_count);
+	if (len >= configCOMMAND_INT_MAX_OUTPUT_SIZE) {
+		/* The message was truncated, the terminating null character is not transmitted */
+		len = configCOMMAND_INT_MAX_OUTPUT_SIZE - 1;
+	}
+
+	uart_tx_commit(lane, handle, (uint16_t)len);
+}
+#endif
+
+#if (1 == LOG_BINARY)
+/**
+  * @brief  Writes a time synchronization frame to the UART TX ring buffer
+  * @param  now current timestamp, see timestamp_get
+  * @retval None
+  * @note	The frame carries the seconds of the day and the timestamp at which
+  * 		that second started.
+  */
+static void log_binary_write_sync(uint32_t now)
+{
+	uint32_t seconds;
+	uint32_t microseconds;
+	uint16_t handle;
+
+	timestamp_to_time_of_day(now, &seconds, &microseconds);
+	const uint32_t second_start = now - microseconds;
+
+	uint8_t *pbuf = uart_tx_reserve(UART_TX_LANE_BULK, LOG_RECORD_FRAME_MAX_SIZE, &handle);
+	const size_t len = log_record_encode_sync(pbuf, seconds, second_start);
+	uart_tx_commit(UART_TX_LANE_BULK, handle, (uint16_t)len);
+
+	log_binary_sync_timestamp = now;
+	log_binary_last_timestamp = second_start;
+	log_binary_synced         = true;
+}
+
+/**
+  * @brief  Writes one captured log record to the UART TX ring buffer as a binary frame
+  * @param  record points to the log record
+  * @retval None
+  */
+static void log_binary_write(const log_record_t *record)
+{
+	uint16_t handle;
+
+	uint8_t *pbuf = uart_tx_reserve(UART_TX_LANE_BULK, LOG_RECORD_FRAME_MAX_SIZE, &handle);
+	const size_t len = log_record_encode(pbuf, record, (int32_t)(record->timestamp - log_binary_last_timestamp));
+	uart_tx_commit(UART_TX_LANE_BULK, handle, (uint16_t)len);
+
+	log_binary_last_timestamp = record->timestamp;
+}
+#endif
+
+/**
+  * @brief  Reads one byte from the UART RX stream buffer
+  * @param  ch the byte read from the stream buffer
   * @retval pdTRUE if the read was successful, pdFALSE otherwise
   * @note	This function might cause the calling task to go to the blocked state
-  * 		if the queue is empty
+  * 		if the stream buffer is empty
   *
   */
 uint32_t cli_io_read(uint8_t *ch)
 {
-	BaseType_t ret = xQueueReceive(uart_rx_queue_handle, ch, portMAX_DELAY);
-	assert_param(pdTRUE == ret);
+	const size_t len = xStreamBufferReceive(uart_rx_stream_buffer_handle, ch, 1, portMAX_DELAY);
+	assert_param(1 == len);
 
-	return (uint32_t)ret;
+	return (1 == len) ? pdTRUE : pdFALSE;
 }
 
 /**
-  * @brief  Writes text messages used by the CLI task to the UART TX queue
+  * @brief  Reads every byte available in the UART RX stream buffer
+  * @param  buf points where the bytes can be stored
+  * @param  max size of buf
+  * @param  ticks_to_wait maximum time to wait for the first byte,
+  * 		portMAX_DELAY to wait forever
+  * @retval number of bytes read, 0 if the wait timed out
+  * @note	This function might cause the calling task to go to the blocked state
+  * 		if the stream buffer is empty. It returns as soon as there is at
+  * 		least one byte, without waiting for max bytes.
+  */
+size_t cli_io_read_bulk(uint8_t *buf, size_t max, TickType_t ticks_to_wait)
+{
+	assert_param(NULL != buf);
+
+	return xStreamBufferReceive(uart_rx_stream_buffer_handle, buf, max, ticks_to_wait);
+}
+
+/**
+  * @brief  Writes text messages used by the CLI task to the UART TX ring buffer
   * @param  s the const string containing the message to be printed
   * @param  size of the string
   * @retval None
   * @note	This function might cause the calling task to go to the blocked state
-  * 		if the tx available queue is empty or the ready queue is full
+  * 		if there is no free space in the TX ring buffer
   */
 void cli_io_write(const char * s, uint16_t size)
 {
-	uart_tx_data_t data = {
-		.pbuf = NULL,
-		.size = 0,
-	};
+	uint16_t handle;
 
-	BaseType_t ret;
+	if (0 == size) {
+		return;
+	}
 
-	ret = xQueueReceive(uart_tx_available_queue_handle, &data.pbuf, portMAX_DELAY);
-	assert_param(pdTRUE == ret);
+	char *pbuf = cli_io_reserve(size, &handle);
+	memcpy(pbuf, s, size);
+	cli_io_commit(handle, size);
+}
 
-	memcpy(data.pbuf, s, size);
-	data.size = size;
+/**
+  * @brief  Reserves space in the UART TX ring buffer, so the CLI output can be
+  * 		formatted directly into the memory the DMA transmits from
+  * @param  size maximum size of the message
+  * @param  handle points where the handle of the reservation can be stored
+  * @retval pointer to the reserved region
+  * @note	This function might cause the calling task to go to the blocked state
+  * 		if there is no free space in the TX ring buffer
+  * @note	The messages reserved later are not transmitted before this one is
+  * 		committed, so the reservation should not be held longer than needed.
+  * @note	No logging while holding the reservation. A log message reserved
+  * 		behind it is not sent before the commit, and with LOG_POLICY_BLOCK
+  * 		the task deadlocks once the ring buffer is full. The CLI commands
+  * 		format into the CLI buffer and are not affected.
+  */
+char *cli_io_reserve(uint16_t size, uint16_t *handle)
+{
+	assert_param(size <= UART_TX_BUFFER_SIZE);
+
+	return (char *)uart_tx_reserve(UART_TX_LANE_BULK, size, handle);
+}
+
+/**
+  * @brief  Commits a message reserved with cli_io_reserve for transmission
+  * @param  handle of the reservation returned by cli_io_reserve
+  * @param  size of the message, the unused part of the reservation is given
+  * 		back if possible. It can be 0, then nothing is transmitted.
+  * @retval None
+  */
+void cli_io_commit(uint16_t handle, uint16_t size)
+{
+	uart_tx_commit(UART_TX_LANE_BULK, handle, size);
+}
+
+/**
+  * @brief  Gets a snapshot of the UART TX statistics
+  * @param  stats points where the statistics can be stored
+  * @retval None
+  */
+void log_and_cli_io_get_tx_stats(uart_tx_stats_t *stats)
+{
+	taskENTER_CRITICAL();
+	*stats = uart_tx_stats;
+	taskEXIT_CRITICAL();
+}
+
+/**
+  * @brief  Gets a snapshot of the UART RX statistics
+  * @param  stats points where the statistics can be stored
+  * @retval None
+  */
+void log_and_cli_io_get_rx_stats(uart_rx_stats_t *stats)
+{
+	taskENTER_CRITICAL();
+	*stats = uart_rx_stats;
+	taskEXIT_CRITICAL();
+}
+
+/**
+  * @brief  Gets a snapshot of the dropped log message counters
+  * @param  stats points where the counters can be stored
+  * @retval None
+  */
+void log_and_cli_io_get_drop_stats(log_drop_stats_t *stats)
+{
+	taskENTER_CRITICAL();
+	*stats = log_drop_stats;
+	taskEXIT_CRITICAL();
+}
+
+/**
+  * @brief  Gets a snapshot of the latency histogram of a UART TX lane
+  * @param  lane of the histogram
+  * @param  latency points where the histogram can be stored
+  * @retval None
+  */
+void log_and_cli_io_get_tx_latency(uart_tx_lane_t lane, uart_tx_latency_t *latency)
+{
+	assert_param(lane < UART_TX_LANE_COUNT);
 
-	ret = xQueueSend(uart_tx_ready_queue_handle, &data, portMAX_DELAY);
-	assert_param(pdTRUE == ret);
+	taskENTER_CRITICAL();
+	*latency = uart_tx_lanes[lane].latency;
+	taskEXIT_CRITICAL();
 }
 
 
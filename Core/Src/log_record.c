@@ -0,0 +1,447 @@
+/*
+ * log_record.c
+ *
+ *  Created on: 2026. okt. 17.
+ *      Author: Balint
+ */
+#include "log_record.h"
+#include "printf.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+/* Size of the buffer a single conversion specification is copied into */
+#define LOG_RECORD_SPEC_SIZE						24
+
+typedef enum {
+	LOG_ARG_NONE,
+	LOG_ARG_WORD,
+	LOG_ARG_POINTER,
+	LOG_ARG_LONG_LONG,
+	LOG_ARG_DOUBLE
+} log_arg_type_t;
+
+static const char *log_record_parse_spec(const char *p, log_arg_type_t *type, uint32_t *stars);
+static uint32_t log_record_arg_words(log_arg_type_t type, uint32_t stars);
+static size_t log_record_put_varint(uint8_t *payload, size_t len, uint32_t value);
+static size_t log_record_frame(uint8_t *frame, const uint8_t *payload, size_t len);
+static bool is_digit(char ch);
+
+/**
+  * @brief  Captures the raw argument words of a log message
+  * @param  format string with optional format specifiers
+  * @param  va list containing the arguments defined by format
+  * @param  args points where the argument words can be stored
+  * @param  max_args maximum number of words that can be stored
+  * @retval number of words stored
+  * @note	The format string is only scanned for the argument types, no
+  * 		formatting is done. Arguments that do not fit are dropped and
+  * 		the output is cut at the first conversion without an argument.
+  */
+uint32_t log_record_capture(const char *format, va_list va, uint32_t *args, uint32_t max_args)
+{
+	log_arg_type_t type;
+	uint32_t stars;
+	uint32_t n = 0;
+
+	while ('\0' != *format) {
+		if ('%' != *format++) {
+			continue;
+		}
+
+		format = log_record_parse_spec(format, &type, &stars);
+		if (NULL == format) {
+			break;
+		}
+
+		const uint32_t words = log_record_arg_words(type, stars);
+		if (n + words > max_args) {
+			break;
+		}
+
+		for (uint32_t i = 0; i < stars; i++) {
+			args[n++] = (uint32_t)va_arg(va, int);
+		}
+
+		switch (type) {
+		case LOG_ARG_WORD:
+			args[n++] = va_arg(va, uint32_t);
+			break;
+
+		case LOG_ARG_POINTER:
+			args[n++] = (uint32_t)(uintptr_t)va_arg(va, void *);
+			break;
+
+		case LOG_ARG_LONG_LONG: {
+			const unsigned long long value = va_arg(va, unsigned long long);
+			memcpy(&args[n], &value, sizeof(value));
+			n = n + 2;
+			break;
+		}
+
+		case LOG_ARG_DOUBLE: {
+			const double value = va_arg(va, double);
+			memcpy(&args[n], &value, sizeof(value));
+			n = n + 2;
+			break;
+		}
+
+		default:
+			break;
+		}
+	}
+
+	return n;
+}
+
+/**
+  * @brief  Formats a log message from the captured argument words
+  * @param  buffer points where the string can be stored
+  * @param  size of the buffer including the terminating null character
+  * @param  format string the arguments were captured with
+  * @param  args points to the words stored by log_record_capture
+  * @param  arg_count number of words
+  * @retval number of characters that could have been written, not counting
+  * 		the terminating null character (same as vsnprintf)
+  * @note	Literal text is copied directly, each conversion is formatted by
+  * 		a separate snprintf call with its argument passed by type. '*'
+  * 		width and precision are written into the specification.
+  */
+int log_record_format(char *buffer, size_t size, const char *format, const uint32_t *args, uint32_t arg_count)
+{
+	char spec[LOG_RECORD_SPEC_SIZE];
+	log_arg_type_t type;
+	uint32_t stars;
+	size_t idx = 0;
+	uint32_t n = 0;
+
+	while ('\0' != *format) {
+		if ('%' != *format) {
+			if (idx + 1U < size) {
+				buffer[idx] = *format;
+			}
+			idx++;
+			format++;
+			continue;
+		}
+
+		const char *start = format;
+		const char *end   = log_record_parse_spec(format + 1, &type, &stars);
+		const uint32_t words = log_record_arg_words(type, stars);
+
+		if ((NULL == end) || (n + words > arg_count)) {
+			/* Incomplete specification or the argument was not captured */
+			break;
+		}
+
+		/* Copy the specification, substituting the '*' fields */
+		const uint32_t *value_args = &args[n + stars];
+		uint32_t star = n;
+		size_t len = 0;
+		for (const char *p = start; (p < end) && (len < LOG_RECORD_SPEC_SIZE - 1U); p++) {
+			if ('*' != *p) {
+				spec[len++] = *p;
+				continue;
+			}
+
+			int value = (int)args[star++];
+			if (('.' == *(p - 1)) && (value < 0)) {
+				value = 0;
+			}
+
+			const int l = snprintf(&spec[len], LOG_RECORD_SPEC_SIZE - len, "%d", value);
+			len = ((size_t)l < LOG_RECORD_SPEC_SIZE - len) ? len + (size_t)l : LOG_RECORD_SPEC_SIZE - 1U;
+		}
+		spec[len] = '\0';
+
+		char  *out       = (idx < size) ? &buffer[idx] : NULL;
+		size_t remaining = (idx < size) ? size - idx : 0U;
+		int    written   = 0;
+
+		switch (type) {
+		case LOG_ARG_WORD:
+			written = snprintf(out, remaining, spec, (unsigned int)value_args[0]);
+			break;
+
+		case LOG_ARG_POINTER:
+			written = snprintf(out, remaining, spec, (void *)(uintptr_t)value_args[0]);
+			break;
+
+		case LOG_ARG_LONG_LONG: {
+			unsigned long long value;
+			memcpy(&value, value_args, sizeof(value));
+			written = snprintf(out, remaining, spec, value);
+			break;
+		}
+
+		case LOG_ARG_DOUBLE: {
+			double value;
+			memcpy(&value, value_args, sizeof(value));
+			written = snprintf(out, remaining, spec, value);
+			break;
+		}
+
+		default:
+			written = snprintf(out, remaining, spec);
+			break;
+		}
+
+		n      = n + words;
+		idx    = idx + (size_t)written;
+		format = end;
+	}
+
+	if (0U != size) {
+		buffer[(idx < size) ? idx : size - 1U] = '\0';
+	}
+
+	return (int)idx;
+}
+
+/**
+  * @brief  Encodes a log record into a binary frame
+  * @param  frame points where the frame can be stored, it must be at least
+  * 		LOG_RECORD_FRAME_MAX_SIZE bytes long
+  * @param  record points to the log record
+  * @param  timestamp_delta timestamp of the record minus the timestamp of
+  * 		the previous frame in microseconds
+  * @retval size of the frame in bytes
+  * @note	The strings are not transmitted, the host decoder looks up the
+  * 		format and type addresses in the ELF file of the firmware.
+  */
+size_t log_record_encode(uint8_t *frame, const log_record_t *record, int32_t timestamp_delta)
+{
+	uint8_t payload[LOG_RECORD_PAYLOAD_MAX_SIZE];
+	size_t len = 0;
+
+	len = log_record_put_varint(payload, len, (uint32_t)(uintptr_t)record->format - LOG_RECORD_ADDRESS_BASE);
+	len = log_record_put_varint(payload, len, (uint32_t)(uintptr_t)record->type - LOG_RECORD_ADDRESS_BASE);
+	len = log_record_put_varint(payload, len, ((uint32_t)timestamp_delta << 1) ^ (uint32_t)(timestamp_delta >> 31));
+
+	for (uint32_t i = 0; i < record->arg_count; i++) {
+		len = log_record_put_varint(payload, len, record->args[i]);
+	}
+
+	return log_record_frame(frame, payload, len);
+}
+
+/**
+  * @brief  Encodes a time synchronization frame
+  * @param  frame points where the frame can be stored, it must be at least
+  * 		LOG_RECORD_FRAME_MAX_SIZE bytes long
+  * @param  seconds_of_day wall-clock time in seconds since midnight
+  * @param  timestamp microsecond timestamp at which seconds_of_day started
+  * @retval size of the frame in bytes
+  * @note	The timestamp deltas of the following log frames are relative to
+  * 		this frame, the decoder derives the wall-clock time from it.
+  */
+size_t log_record_encode_sync(uint8_t *frame, uint32_t seconds_of_day, uint32_t timestamp)
+{
+	uint8_t payload[15];
+	size_t len = 0;
+
+	len = log_record_put_varint(payload, len, 0);
+	len = log_record_put_varint(payload, len, seconds_of_day);
+	len = log_record_put_varint(payload, len, timestamp);
+
+	return log_record_frame(frame, payload, len);
+}
+
+/**
+  * @brief  Appends an unsigned LEB128 varint to the payload
+  * @param  payload points to the payload
+  * @param  len current length of the payload
+  * @param  value to be appended
+  * @retval new length of the payload
+  */
+static size_t log_record_put_varint(uint8_t *payload, size_t len, uint32_t value)
+{
+	while (value >= 0x80U) {
+		payload[len++] = (uint8_t)(value | 0x80U);
+		value = value >> 7;
+	}
+	payload[len++] = (uint8_t)value;
+
+	return len;
+}
+
+/**
+  * @brief  COBS encodes the payload between two 0x00 delimiters
+  * @param  frame points where the frame can be stored
+  * @param  payload points to the payload
+  * @param  len length of the payload
+  * @retval size of the frame in bytes
+  */
+static size_t log_record_frame(uint8_t *frame, const uint8_t *payload, size_t len)
+{
+	size_t idx = 0;
+
+	frame[idx++] = 0x00;
+
+	size_t code_idx = idx++;
+	uint8_t code = 1;
+
+	for (size_t i = 0; i < len; i++) {
+		if (0x00 != payload[i]) {
+			frame[idx++] = payload[i];
+			code++;
+		}
+
+		if ((0x00 == payload[i]) || (0xFF == code)) {
+			frame[code_idx] = code;
+			code_idx = idx++;
+			code = 1;
+		}
+	}
+
+	frame[code_idx] = code;
+	frame[idx++] = 0x00;
+
+	return idx;
+}
+
+/**
+  * @brief  Parses a conversion specification
+  * @param  p points to the first character after the '%'
+  * @param  type points where the type of the argument can be stored
+  * @param  stars points where the number of '*' fields can be stored
+  * @retval pointer to the first character after the specification,
+  * 		NULL if the string ends inside the specification
+  * @note	Follows the grammar accepted by _vsnprintf in printf.c:
+  * 		%[flags][width][.precision][length]specifier, the fixed point
+  * 		specifier 'q' may be followed by its number of fraction bits
+  */
+static const char *log_record_parse_spec(const char *p, log_arg_type_t *type, uint32_t *stars)
+{
+	bool long_long = false;
+
+	*stars = 0;
+
+	while (('0' == *p) || ('-' == *p) || ('+' == *p) || (' ' == *p) || ('#' == *p)) {
+		p++;
+	}
+
+	if ('*' == *p) {
+		*stars = *stars + 1;
+		p++;
+	} else {
+		while (true == is_digit(*p)) {
+			p++;
+		}
+	}
+
+	if ('.' == *p) {
+		p++;
+		if ('*' == *p) {
+			*stars = *stars + 1;
+			p++;
+		} else {
+			while (true == is_digit(*p)) {
+				p++;
+			}
+		}
+	}
+
+	switch (*p) {
+	case 'l':
+		p++;
+		if ('l' == *p) {
+			long_long = true;
+			p++;
+		}
+		break;
+	case 'h':
+		p++;
+		if ('h' == *p) {
+			p++;
+		}
+		break;
+	case 't':
+		long_long = (sizeof(ptrdiff_t) != sizeof(long));
+		p++;
+		break;
+	case 'j':
+		long_long = (sizeof(intmax_t) != sizeof(long));
+		p++;
+		break;
+	case 'z':
+		long_long = (sizeof(size_t) != sizeof(long));
+		p++;
+		break;
+	default:
+		break;
+	}
+
+	switch (*p) {
+	case 'd':
+	case 'i':
+	case 'u':
+	case 'x':
+	case 'X':
+	case 'o':
+	case 'b':
+	case 'k':
+		*type = (true == long_long) ? LOG_ARG_LONG_LONG : LOG_ARG_WORD;
+		break;
+	case 'q':
+		/* Followed by the optional number of fraction bits */
+		*type = (true == long_long) ? LOG_ARG_LONG_LONG : LOG_ARG_WORD;
+		while (true == is_digit(p[1])) {
+			p++;
+		}
+		break;
+	case 'c':
+		*type = LOG_ARG_WORD;
+		break;
+	case 'f':
+	case 'F':
+	case 'e':
+	case 'E':
+	case 'g':
+	case 'G':
+		*type = LOG_ARG_DOUBLE;
+		break;
+	case 's':
+	case 'p':
+		*type = LOG_ARG_POINTER;
+		break;
+	case '\0':
+		/* Incomplete specification at the end of the string */
+		*type = LOG_ARG_NONE;
+		return NULL;
+	default:
+		*type = LOG_ARG_NONE;
+		break;
+	}
+
+	return p + 1;
+}
+
+/**
+  * @brief  Gets the number of argument words a conversion takes
+  * @param  type of the argument
+  * @param  stars number of '*' fields of the conversion
+  * @retval number of 32-bit words
+  */
+static uint32_t log_record_arg_words(log_arg_type_t type, uint32_t stars)
+{
+	uint32_t words = stars;
+
+	if ((LOG_ARG_LONG_LONG == type) || (LOG_ARG_DOUBLE == type)) {
+		words = words + 2U;
+	} else if (LOG_ARG_NONE != type) {
+		words = words + 1U;
+	}
+
+	return words;
+}
+
+/**
+  * @brief  Checks whether a character is a decimal digit or not
+  * @param	ch the character to be checked
+  * @retval true if ch is between '0' and '9', false otherwise
+  */
+static bool is_digit(char ch)
+{
+	return ((ch >= '0') && (ch <= '9'));
+}
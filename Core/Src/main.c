@@ -7,6 +7,8 @@
   *
   ******************************************************************************
   */
+#define LOG_MODULE LOG_MODULE_MAIN
+
 #include "stm32f4xx_hal.h"
 #include "gpio.h"
 #include "FreeRTOS.h"
@@ -18,6 +20,8 @@
 
 #include "log.h"
 #include "cli.h"
+#include "irq_stats.h"
+#include "cpu_load.h"
 #include "FreeRTOS_CLI.h"
 #include "SEGGER_SYSVIEW.h"
 #include "fatfs.h"
@@ -44,13 +48,15 @@ int main(void)
 	HAL_Init();
 	SystemClock_Config();
 	SEGGER_SYSVIEW_Conf();
+	irq_stats_init();
 
 	GPIO_Init();
 
 	MX_FATFS_Init();
 
 	log_init();
-	cli_init(FreeRTOS_CLIGetOutputBuffer(), FreeRTOS_CLIProcessCommand);
+	cli_init(FreeRTOS_CLIProcessCommand);
+	cpu_load_init();
 
 	xTaskCreate(
 				task_b,
@@ -30,8 +30,10 @@
 //
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "printf.h"
 
@@ -70,18 +72,30 @@
 #define PRINTF_SUPPORT_EXPONENTIAL
 #endif
 
+// support for the shortest round trip representation with %g/%G without precision
+// default: activated
+#ifndef PRINTF_DISABLE_SUPPORT_SHORTEST_FLOAT
+#define PRINTF_SUPPORT_SHORTEST_FLOAT
+#endif
+
+// support for the fixed point (%q) and scaled integer (%k) types
+// default: activated
+#ifndef PRINTF_DISABLE_SUPPORT_FIXED_POINT
+#define PRINTF_SUPPORT_FIXED_POINT
+#endif
+
+// define the number of fraction bits of %q when none follow the specifier
+// default: 16, Q15.16
+#ifndef PRINTF_DEFAULT_FRACTION_BITS
+#define PRINTF_DEFAULT_FRACTION_BITS  16U
+#endif
+
 // define the default floating point precision
 // default: 6 digits
 #ifndef PRINTF_DEFAULT_FLOAT_PRECISION
 #define PRINTF_DEFAULT_FLOAT_PRECISION  6U
 #endif
 
-// define the largest float suitable to print with %f
-// default: 1e9
-#ifndef PRINTF_MAX_FLOAT
-#define PRINTF_MAX_FLOAT  1e9
-#endif
-
 // support for the long long types (%llu or %p)
 // default: activated
 #ifndef PRINTF_DISABLE_SUPPORT_LONG_LONG
@@ -95,6 +109,36 @@
 #define PRINTF_SUPPORT_PTRDIFF_T
 #endif
 
+// number of parsed format strings ("programs") cached by format address, 0 disables the cache
+// repeated calls with the same format run the program and skip parsing
+// each program takes 8 + 12 * PRINTF_FORMAT_PROGRAM_MAX_STEPS bytes of RAM, 16 programs about 1.7 KB
+// enable it where printf-cycles shows a gain worth the RAM
+// default: deactivated
+#ifndef PRINTF_FORMAT_CACHE_SIZE
+#define PRINTF_FORMAT_CACHE_SIZE  0U
+#endif
+
+// literal run + conversion steps per program, formats with more conversions are not cached
+// default: 8 steps
+#ifndef PRINTF_FORMAT_PROGRAM_MAX_STEPS
+#define PRINTF_FORMAT_PROGRAM_MAX_STEPS  8U
+#endif
+
+// number of slots probed on a lookup
+// default: 4 slots
+#ifndef PRINTF_FORMAT_CACHE_PROBES
+#define PRINTF_FORMAT_CACHE_PROBES  4U
+#endif
+
+// only formats in this address range are cached, the contents at a cached address must never change
+// default: the internal flash of the STM32F407, where the string literals live
+#ifndef PRINTF_FORMAT_CACHE_ADDRESS_MIN
+#define PRINTF_FORMAT_CACHE_ADDRESS_MIN  0x08000000UL
+#endif
+#ifndef PRINTF_FORMAT_CACHE_ADDRESS_MAX
+#define PRINTF_FORMAT_CACHE_ADDRESS_MAX  0x080FFFFFUL
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
 
 // internal flag definitions
@@ -110,17 +154,35 @@
 #define FLAGS_LONG_LONG (1U <<  9U)
 #define FLAGS_PRECISION (1U << 10U)
 #define FLAGS_ADAPT_EXP (1U << 11U)
+#define FLAGS_WIDTH_ARG     (1U << 12U)
+#define FLAGS_PRECISION_ARG (1U << 13U)
 
 
 // import float.h for DBL_MAX
 #if defined(PRINTF_SUPPORT_FLOAT)
 #include <float.h>
+#include <math.h>
 #endif
 
 
 // output function type
 typedef void (*out_fct_type)(char character, void* buffer, size_t idx, size_t maxlen);
 
+// span output function type, outputs 'len' characters of 'str' starting at 'idx'
+typedef void (*out_span_fct_type)(const char* str, size_t len, void* buffer, size_t idx, size_t maxlen);
+
+// fill output function type, outputs 'count' copies of 'character' starting at 'idx'
+typedef void (*out_fill_fct_type)(char character, size_t count, void* buffer, size_t idx, size_t maxlen);
+
+
+// output sink, the per character function is kept for single characters and
+// the termination, literal runs, strings and padding go through span and fill
+typedef struct {
+  out_fct_type      fct;
+  out_span_fct_type span;
+  out_fill_fct_type fill;
+} out_sink_type;
+
 
 // wrapper (used as buffer) for output function type
 typedef struct {
@@ -138,6 +200,24 @@ static inline void _out_buffer(char character, void* buffer, size_t idx, size_t
 }
 
 
+// internal buffer span output, truncated at maxlen
+static void _out_buffer_span(const char* str, size_t len, void* buffer, size_t idx, size_t maxlen)
+{
+  if (idx < maxlen) {
+    memcpy((char*)buffer + idx, str, (len < maxlen - idx) ? len : maxlen - idx);
+  }
+}
+
+
+// internal buffer fill output, truncated at maxlen
+static void _out_buffer_fill(char character, size_t count, void* buffer, size_t idx, size_t maxlen)
+{
+  if (idx < maxlen) {
+    memset((char*)buffer + idx, character, (count < maxlen - idx) ? count : maxlen - idx);
+  }
+}
+
+
 // internal null output
 static inline void _out_null(char character, void* buffer, size_t idx, size_t maxlen)
 {
@@ -145,6 +225,20 @@ static inline void _out_null(char character, void* buffer, size_t idx, size_t ma
 }
 
 
+// internal null span output
+static void _out_null_span(const char* str, size_t len, void* buffer, size_t idx, size_t maxlen)
+{
+  (void)str; (void)len; (void)buffer; (void)idx; (void)maxlen;
+}
+
+
+// internal null fill output
+static void _out_null_fill(char character, size_t count, void* buffer, size_t idx, size_t maxlen)
+{
+  (void)character; (void)count; (void)buffer; (void)idx; (void)maxlen;
+}
+
+
 // internal _putchar wrapper
 static inline void _out_char(char character, void* buffer, size_t idx, size_t maxlen)
 {
@@ -155,6 +249,26 @@ static inline void _out_char(char character, void* buffer, size_t idx, size_t ma
 }
 
 
+// internal _putchar span wrapper
+static void _out_char_span(const char* str, size_t len, void* buffer, size_t idx, size_t maxlen)
+{
+  (void)buffer; (void)idx; (void)maxlen;
+  while (len--) {
+    _putchar(*(str++));
+  }
+}
+
+
+// internal _putchar fill wrapper
+static void _out_char_fill(char character, size_t count, void* buffer, size_t idx, size_t maxlen)
+{
+  (void)buffer; (void)idx; (void)maxlen;
+  while (count--) {
+    _putchar(character);
+  }
+}
+
+
 // internal output function wrapper
 static inline void _out_fct(char character, void* buffer, size_t idx, size_t maxlen)
 {
@@ -166,6 +280,55 @@ static inline void _out_fct(char character, void* buffer, size_t idx, size_t max
 }
 
 
+// internal output function span wrapper
+static void _out_fct_span(const char* str, size_t len, void* buffer, size_t idx, size_t maxlen)
+{
+  (void)idx; (void)maxlen;
+  while (len--) {
+    ((out_fct_wrap_type*)buffer)->fct(*(str++), ((out_fct_wrap_type*)buffer)->arg);
+  }
+}
+
+
+// internal output function fill wrapper
+static void _out_fct_fill(char character, size_t count, void* buffer, size_t idx, size_t maxlen)
+{
+  (void)idx; (void)maxlen;
+  while (count--) {
+    ((out_fct_wrap_type*)buffer)->fct(character, ((out_fct_wrap_type*)buffer)->arg);
+  }
+}
+
+
+// output sinks
+static const out_sink_type _sink_buffer = { _out_buffer, _out_buffer_span, _out_buffer_fill };
+static const out_sink_type _sink_null   = { _out_null,   _out_null_span,   _out_null_fill   };
+static const out_sink_type _sink_char   = { _out_char,   _out_char_span,   _out_char_fill   };
+static const out_sink_type _sink_fct    = { _out_fct,    _out_fct_span,    _out_fct_fill    };
+
+
+// output a span of characters
+// \return The index following the span
+static inline size_t _out_span(const out_sink_type* out, char* buffer, size_t idx, size_t maxlen, const char* str, size_t len)
+{
+  if (len) {
+    out->span(str, len, buffer, idx, maxlen);
+  }
+  return idx + len;
+}
+
+
+// output 'count' copies of a character, used for padding
+// \return The index following the fill
+static inline size_t _out_fill(const out_sink_type* out, char* buffer, size_t idx, size_t maxlen, char character, size_t count)
+{
+  if (count) {
+    out->fill(character, count, buffer, idx, maxlen);
+  }
+  return idx + count;
+}
+
+
 // internal secure strlen
 // \return The length of the string (excluding the terminating 0) limited by 'maxsize'
 static inline unsigned int _strnlen_s(const char* str, size_t maxsize)
@@ -196,35 +359,123 @@ static unsigned int _atoi(const char** str)
 
 
 // output the specified string in reverse, taking care of any zero-padding
-static size_t _out_rev(out_fct_type out, char* buffer, size_t idx, size_t maxlen, const char* buf, size_t len, unsigned int width, unsigned int flags)
+static size_t _out_rev(const out_sink_type* out, char* buffer, size_t idx, size_t maxlen, const char* buf, size_t len, unsigned int width, unsigned int flags)
 {
-  const size_t start_idx = idx;
+  char rev[(PRINTF_NTOA_BUFFER_SIZE > PRINTF_FTOA_BUFFER_SIZE) ? PRINTF_NTOA_BUFFER_SIZE : PRINTF_FTOA_BUFFER_SIZE];
+  const size_t pad = (len < width) ? width - len : 0U;
 
   // pad spaces up to given width
   if (!(flags & FLAGS_LEFT) && !(flags & FLAGS_ZEROPAD)) {
-    for (size_t i = len; i < width; i++) {
-      out(' ', buffer, idx++, maxlen);
-    }
+    idx = _out_fill(out, buffer, idx, maxlen, ' ', pad);
   }
 
-  // reverse string
-  while (len) {
-    out(buf[--len], buffer, idx++, maxlen);
+  // reverse string, output as one span
+  for (size_t i = 0U; i < len; i++) {
+    rev[i] = buf[len - 1U - i];
   }
+  idx = _out_span(out, buffer, idx, maxlen, rev, len);
 
   // append pad spaces up to given width
   if (flags & FLAGS_LEFT) {
-    while (idx - start_idx < width) {
-      out(' ', buffer, idx++, maxlen);
-    }
+    idx = _out_fill(out, buffer, idx, maxlen, ' ', pad);
   }
 
   return idx;
 }
 
 
+// two digit lookup table for the decimal conversion, "00" to "99"
+static const char _dec_digit_pairs[200] =
+  "0001020304050607080910111213141516171819"
+  "2021222324252627282930313233343536373839"
+  "4041424344454647484950515253545556575859"
+  "6061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+
+// internal digit conversion of a 32-bit value, digits are written reversed
+// base 10 converts two digits per step, the division by the constant 100 compiles
+// to a reciprocal multiplication; the power of 2 bases use shift and mask
+// \return The number of digits written to buf
+static size_t _ntoa_digits(char* buf, uint32_t value, unsigned int base, unsigned int flags)
+{
+  size_t len = 0U;
+
+  if (base == 10U) {
+    while ((value >= 100U) && (len + 2U <= PRINTF_NTOA_BUFFER_SIZE)) {
+      const uint32_t pair = (value % 100U) * 2U;
+      value /= 100U;
+      buf[len++] = _dec_digit_pairs[pair + 1U];
+      buf[len++] = _dec_digit_pairs[pair];
+    }
+    if ((value >= 10U) && (len + 2U <= PRINTF_NTOA_BUFFER_SIZE)) {
+      buf[len++] = _dec_digit_pairs[(value * 2U) + 1U];
+      buf[len++] = _dec_digit_pairs[value * 2U];
+    }
+    else if (len < PRINTF_NTOA_BUFFER_SIZE) {
+      buf[len++] = (char)('0' + value);
+    }
+  }
+  else {
+    const char* digits = (flags & FLAGS_UPPERCASE) ? "0123456789ABCDEF" : "0123456789abcdef";
+    const unsigned int shift = (base == 16U) ? 4U : (base == 8U) ? 3U : 1U;
+    do {
+      buf[len++] = digits[value & (base - 1U)];
+      value >>= shift;
+    } while (value && (len < PRINTF_NTOA_BUFFER_SIZE));
+  }
+
+  return len;
+}
+
+
+// internal high 64 bits of a 64 x 64 bit multiplication, built from 32-bit multiplications
+static inline uint64_t _umulh64(uint64_t a, uint64_t b)
+{
+  const uint64_t ll = (uint64_t)(uint32_t)a * (uint32_t)b;
+  const uint64_t lh = (uint64_t)(uint32_t)a * (uint32_t)(b >> 32U);
+  const uint64_t hl = (uint64_t)(uint32_t)(a >> 32U) * (uint32_t)b;
+  const uint64_t hh = (uint64_t)(uint32_t)(a >> 32U) * (uint32_t)(b >> 32U);
+  const uint64_t mid = (ll >> 32U) + (uint32_t)lh + (uint32_t)hl;
+  return hh + (lh >> 32U) + (hl >> 32U) + (mid >> 32U);
+}
+
+
+#if defined(PRINTF_SUPPORT_LONG_LONG)
+// internal digit conversion of a 64-bit value, digits are written reversed
+// base 10 divides by 100 with a reciprocal multiplication instead of __aeabi_uldivmod
+// until the value fits 32 bits, the power of 2 bases use shift and mask
+// \return The number of digits written to buf
+static size_t _ntoa_digits_long_long(char* buf, unsigned long long value, unsigned int base, unsigned int flags)
+{
+  size_t len = 0U;
+
+  if (base == 10U) {
+    while ((value > 0xFFFFFFFFULL) && (len + 2U <= PRINTF_NTOA_BUFFER_SIZE)) {
+      // value / 100 == ((value >> 2) * ceil(2^68 / 100)) >> 68
+      const unsigned long long quot = _umulh64(value >> 2U, 0x28F5C28F5C28F5C3ULL) >> 2U;
+      const uint32_t pair = (uint32_t)(value - (quot * 100U)) * 2U;
+      value = quot;
+      buf[len++] = _dec_digit_pairs[pair + 1U];
+      buf[len++] = _dec_digit_pairs[pair];
+    }
+    return len + _ntoa_digits(&buf[len], (uint32_t)value, base, flags);
+  }
+
+  const char* digits = (flags & FLAGS_UPPERCASE) ? "0123456789ABCDEF" : "0123456789abcdef";
+  const unsigned int shift = (base == 16U) ? 4U : (base == 8U) ? 3U : 1U;
+  do {
+    buf[len++] = digits[value & (base - 1U)];
+    value >>= shift;
+  } while (value && (len < PRINTF_NTOA_BUFFER_SIZE));
+
+  return len;
+}
+#endif  // PRINTF_SUPPORT_LONG_LONG
+
+
 // internal itoa format
-static size_t _ntoa_format(out_fct_type out, char* buffer, size_t idx, size_t maxlen, char* buf, size_t len, bool negative, unsigned int base, unsigned int prec, unsigned int width, unsigned int flags)
+static size_t _ntoa_format(const out_sink_type* out, char* buffer, size_t idx, size_t maxlen, char* buf, size_t len, bool negative, unsigned int base, unsigned int prec, unsigned int width, unsigned int flags)
 {
   // pad leading zeros
   if (!(flags & FLAGS_LEFT)) {
@@ -278,7 +529,7 @@ static size_t _ntoa_format(out_fct_type out, char* buffer, size_t idx, size_t ma
 
 
 // internal itoa for 'long' type
-static size_t _ntoa_long(out_fct_type out, char* buffer, size_t idx, size_t maxlen, unsigned long value, bool negative, unsigned long base, unsigned int prec, unsigned int width, unsigned int flags)
+static size_t _ntoa_long(const out_sink_type* out, char* buffer, size_t idx, size_t maxlen, unsigned long value, bool negative, unsigned long base, unsigned int prec, unsigned int width, unsigned int flags)
 {
   char buf[PRINTF_NTOA_BUFFER_SIZE];
   size_t len = 0U;
@@ -290,11 +541,11 @@ static size_t _ntoa_long(out_fct_type out, char* buffer, size_t idx, size_t maxl
 
   // write if precision != 0 and value is != 0
   if (!(flags & FLAGS_PRECISION) || value) {
-    do {
-      const char digit = (char)(value % base);
-      buf[len++] = digit < 10 ? '0' + digit : (flags & FLAGS_UPPERCASE ? 'A' : 'a') + digit - 10;
-      value /= base;
-    } while (value && (len < PRINTF_NTOA_BUFFER_SIZE));
+#if (ULONG_MAX > 0xFFFFFFFFUL) && defined(PRINTF_SUPPORT_LONG_LONG)
+    len = (value > 0xFFFFFFFFUL) ? _ntoa_digits_long_long(buf, value, (unsigned int)base, flags) : _ntoa_digits(buf, (uint32_t)value, (unsigned int)base, flags);
+#else
+    len = _ntoa_digits(buf, (uint32_t)value, (unsigned int)base, flags);
+#endif
   }
 
   return _ntoa_format(out, buffer, idx, maxlen, buf, len, negative, (unsigned int)base, prec, width, flags);
@@ -303,7 +554,7 @@ static size_t _ntoa_long(out_fct_type out, char* buffer, size_t idx, size_t maxl
 
 // internal itoa for 'long long' type
 #if defined(PRINTF_SUPPORT_LONG_LONG)
-static size_t _ntoa_long_long(out_fct_type out, char* buffer, size_t idx, size_t maxlen, unsigned long long value, bool negative, unsigned long long base, unsigned int prec, unsigned int width, unsigned int flags)
+static size_t _ntoa_long_long(const out_sink_type* out, char* buffer, size_t idx, size_t maxlen, unsigned long long value, bool negative, unsigned long long base, unsigned int prec, unsigned int width, unsigned int flags)
 {
   char buf[PRINTF_NTOA_BUFFER_SIZE];
   size_t len = 0U;
@@ -315,11 +566,7 @@ static size_t _ntoa_long_long(out_fct_type out, char* buffer, size_t idx, size_t
 
   // write if precision != 0 and value is != 0
   if (!(flags & FLAGS_PRECISION) || value) {
-    do {
-      const char digit = (char)(value % base);
-      buf[len++] = digit < 10 ? '0' + digit : (flags & FLAGS_UPPERCASE ? 'A' : 'a') + digit - 10;
-      value /= base;
-    } while (value && (len < PRINTF_NTOA_BUFFER_SIZE));
+    len = _ntoa_digits_long_long(buf, value, (unsigned int)base, flags);
   }
 
   return _ntoa_format(out, buffer, idx, maxlen, buf, len, negative, (unsigned int)base, prec, width, flags);
@@ -327,530 +574,1629 @@ static size_t _ntoa_long_long(out_fct_type out, char* buffer, size_t idx, size_t
 #endif  // PRINTF_SUPPORT_LONG_LONG
 
 
-#if defined(PRINTF_SUPPORT_FLOAT)
-
-#if defined(PRINTF_SUPPORT_EXPONENTIAL)
-// forward declaration so that _ftoa can switch to exp notation for values > PRINTF_MAX_FLOAT
-static size_t _etoa(out_fct_type out, char* buffer, size_t idx, size_t maxlen, double value, unsigned int prec, unsigned int width, unsigned int flags);
+#if defined(PRINTF_SUPPORT_FIXED_POINT)
+// widest type of the fixed point conversions
+#if defined(PRINTF_SUPPORT_LONG_LONG)
+typedef unsigned long long fixed_type;
+#else
+typedef uint32_t fixed_type;
 #endif
 
+// a fraction can have as many bits as fixed_type, %q with more prints the specifier instead
+#define FIXED_MAX_FRACTION_BITS  (sizeof(fixed_type) * 8U)
 
-// internal ftoa for fixed decimal floating point
-static size_t _ftoa(out_fct_type out, char* buffer, size_t idx, size_t maxlen, double value, unsigned int prec, unsigned int width, unsigned int flags)
-{
-  char buf[PRINTF_FTOA_BUFFER_SIZE];
-  size_t len  = 0U;
-  double diff = 0.0;
-
-  // powers of 10
-  static const double pow10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
-
-  // test for special values
-  if (value != value)
-    return _out_rev(out, buffer, idx, maxlen, "nan", 3, width, flags);
-  if (value < -DBL_MAX)
-    return _out_rev(out, buffer, idx, maxlen, "fni-", 4, width, flags);
-  if (value > DBL_MAX)
-    return _out_rev(out, buffer, idx, maxlen, (flags & FLAGS_PLUS) ? "fni+" : "fni", (flags & FLAGS_PLUS) ? 4U : 3U, width, flags);
 
-  // test for very large values
-  // standard printf behavior is to print EVERY whole number digit -- which could be 100s of characters overflowing your buffers == bad
-  if ((value > PRINTF_MAX_FLOAT) || (value < -PRINTF_MAX_FLOAT)) {
-#if defined(PRINTF_SUPPORT_EXPONENTIAL)
-    return _etoa(out, buffer, idx, maxlen, value, prec, width, flags);
+// internal reversed decimal digits of a fixed_type value
+// \return The number of digits written to buf
+static size_t _fixed_digits(char* buf, fixed_type value)
+{
+#if defined(PRINTF_SUPPORT_LONG_LONG)
+  return _ntoa_digits_long_long(buf, value, 10U, 0U);
 #else
-    return 0U;
+  return _ntoa_digits(buf, value, 10U, 0U);
 #endif
-  }
+}
 
-  // test for negative
-  bool negative = false;
-  if (value < 0) {
-    negative = true;
-    value = 0 - value;
-  }
 
-  // set default precision, if not set explicitly
-  if (!(flags & FLAGS_PRECISION)) {
-    prec = PRINTF_DEFAULT_FLOAT_PRECISION;
+// internal fixed point output: the sign, the reversed whole digits (at least "0") and, if there
+// is a fraction, the decimal point, 'lead' zeros, the fraction digits and 'trail' zeros
+// the zeros are filled, so the precision is not limited by a buffer
+static size_t _fixed_out(const out_sink_type* out, char* buffer, size_t idx, size_t maxlen, const char* whole, size_t whole_len, const char* frac, size_t frac_len, size_t lead, size_t trail, bool negative, unsigned int width, unsigned int flags)
+{
+  char buf[PRINTF_NTOA_BUFFER_SIZE];
+  if (!whole_len) {
+    whole     = "0";
+    whole_len = 1U;
   }
-  // limit precision to 9, cause a prec >= 10 can lead to overflow errors
-  while ((len < PRINTF_FTOA_BUFFER_SIZE) && (prec > 9U)) {
-    buf[len++] = '0';
-    prec--;
+  for (size_t i = 0U; i < whole_len; i++) {
+    buf[i] = whole[whole_len - 1U - i];
   }
 
-  int whole = (int)value;
-  double tmp = (value - whole) * pow10[prec];
-  unsigned long frac = (unsigned long)tmp;
-  diff = tmp - frac;
+  // sign and zero padding as for integers
+  const char sign = negative ? '-' : (flags & FLAGS_PLUS) ? '+' : (flags & FLAGS_SPACE) ? ' ' : '\0';
+  const size_t frac_total = lead + frac_len + trail;
+  const size_t len = (sign ? 1U : 0U) + whole_len + (frac_total ? frac_total + 1U : 0U);
+  const size_t pad = (len < width) ? width - len : 0U;
 
-  if (diff > 0.5) {
-    ++frac;
-    // handle rollover, e.g. case 0.99 with prec 1 is 1.0
-    if (frac >= pow10[prec]) {
-      frac = 0;
-      ++whole;
-    }
+  if (!(flags & FLAGS_LEFT) && !(flags & FLAGS_ZEROPAD)) {
+    idx = _out_fill(out, buffer, idx, maxlen, ' ', pad);
   }
-  else if (diff < 0.5) {
+  if (sign) {
+    idx = _out_span(out, buffer, idx, maxlen, &sign, 1U);
   }
-  else if ((frac == 0U) || (frac & 1U)) {
-    // if halfway, round up if odd OR if last digit is 0
-    ++frac;
+  if (!(flags & FLAGS_LEFT) && (flags & FLAGS_ZEROPAD)) {
+    idx = _out_fill(out, buffer, idx, maxlen, '0', pad);
   }
-
-  if (prec == 0U) {
-    diff = value - (double)whole;
-    if ((!(diff < 0.5) || (diff > 0.5)) && (whole & 1)) {
-      // exactly 0.5 and ODD, then round up
-      // 1.5 -> 2, but 2.5 -> 2
-      ++whole;
-    }
+  idx = _out_span(out, buffer, idx, maxlen, buf, whole_len);
+  if (frac_total) {
+    idx = _out_fill(out, buffer, idx, maxlen, '.', 1U);
+    idx = _out_fill(out, buffer, idx, maxlen, '0', lead);
+    idx = _out_span(out, buffer, idx, maxlen, frac, frac_len);
+    idx = _out_fill(out, buffer, idx, maxlen, '0', trail);
   }
-  else {
-    unsigned int count = prec;
-    // now do fractional part, as an unsigned number
-    while (len < PRINTF_FTOA_BUFFER_SIZE) {
-      --count;
-      buf[len++] = (char)(48U + (frac % 10U));
-      if (!(frac /= 10U)) {
-        break;
-      }
-    }
-    // add extra 0s
-    while ((len < PRINTF_FTOA_BUFFER_SIZE) && (count-- > 0U)) {
-      buf[len++] = '0';
-    }
-    if (len < PRINTF_FTOA_BUFFER_SIZE) {
-      // add decimal
-      buf[len++] = '.';
-    }
+  if (flags & FLAGS_LEFT) {
+    idx = _out_fill(out, buffer, idx, maxlen, ' ', pad);
   }
+  return idx;
+}
 
-  // do whole part, number is reversed
-  while (len < PRINTF_FTOA_BUFFER_SIZE) {
-    buf[len++] = (char)(48 + (whole % 10));
-    if (!(whole /= 10)) {
-      break;
-    }
+
+// internal scaled integer format, prints value / 10^scale with 'scale' decimals
+static size_t _ktoa(const out_sink_type* out, char* buffer, size_t idx, size_t maxlen, fixed_type value, bool negative, unsigned int scale, unsigned int width, unsigned int flags)
+{
+  char digits[PRINTF_NTOA_BUFFER_SIZE];
+  char frac[PRINTF_NTOA_BUFFER_SIZE];
+  const size_t n = _fixed_digits(digits, value);
+
+  // the low 'scale' digits are the fraction, zero filled if the value is shorter
+  const size_t frac_len = (n < scale) ? n : scale;
+  for (size_t i = 0U; i < frac_len; i++) {
+    frac[i] = digits[frac_len - 1U - i];
   }
 
-  // pad leading zeros
-  if (!(flags & FLAGS_LEFT) && (flags & FLAGS_ZEROPAD)) {
-    if (width && (negative || (flags & (FLAGS_PLUS | FLAGS_SPACE)))) {
-      width--;
-    }
-    while ((len < width) && (len < PRINTF_FTOA_BUFFER_SIZE)) {
-      buf[len++] = '0';
+  // the rest is the whole part, no division by 10^scale
+  return _fixed_out(out, buffer, idx, maxlen, &digits[frac_len], n - frac_len, frac, frac_len, scale - frac_len, 0U, negative, width, flags);
+}
+
+
+// internal Qm.n fixed point format, prints value / 2^fraction_bits rounded to 'decimals' digits
+static size_t _qtoa(const out_sink_type* out, char* buffer, size_t idx, size_t maxlen, fixed_type value, bool negative, unsigned int fraction_bits, unsigned int decimals, unsigned int width, unsigned int flags)
+{
+  char digits[PRINTF_NTOA_BUFFER_SIZE];
+  char frac_digits[FIXED_MAX_FRACTION_BITS];
+  size_t n = 0U;
+
+  if (fraction_bits > FIXED_MAX_FRACTION_BITS) {
+    // no value has that many fraction bits
+    frac_digits[0] = '%';
+    frac_digits[1] = 'q';
+    n = _fixed_digits(digits, fraction_bits);
+    for (size_t i = 0U; i < n; i++) {
+      frac_digits[2U + i] = digits[n - 1U - i];
     }
+    return _out_span(out, buffer, idx, maxlen, frac_digits, 2U + n);
   }
 
-  if (len < PRINTF_FTOA_BUFFER_SIZE) {
-    if (negative) {
-      buf[len++] = '-';
+  // the fraction is left aligned, frac / 2^FIXED_MAX_FRACTION_BITS
+  const unsigned int low_bits = FIXED_MAX_FRACTION_BITS - 4U;
+  const fixed_type low_mask = ((fixed_type)1U << low_bits) - 1U;
+  fixed_type whole = (fraction_bits < FIXED_MAX_FRACTION_BITS) ? (value >> fraction_bits) : 0U;
+  fixed_type frac  = fraction_bits ? (value << (FIXED_MAX_FRACTION_BITS - fraction_bits)) : 0U;
+
+  // fraction digits, most significant first; 10 * frac is formed from the top 4 bits and
+  // the rest separately, so that it does not overflow
+  // a fraction of n bits has exactly n decimals, the digits after those are zeros
+  while ((n < decimals) && (n < fraction_bits)) {
+    const fixed_type low = (frac & low_mask) * 10U;
+    const unsigned int top = (unsigned int)(frac >> low_bits) * 10U + (unsigned int)(low >> low_bits);
+    frac_digits[n++] = (char)('0' + (top >> 4U));
+    frac = ((fixed_type)(top & 15U) << low_bits) | (low & low_mask);
+  }
+
+  // round to nearest, ties to even like %f, carrying into the whole part
+  const fixed_type half = (fixed_type)1U << (FIXED_MAX_FRACTION_BITS - 1U);
+  const bool odd = n ? ((frac_digits[n - 1U] - '0') & 1) : (whole & 1U);
+  if ((frac > half) || ((frac == half) && odd)) {
+    size_t i = n;
+    while (i && (frac_digits[i - 1U] == '9')) {
+      frac_digits[--i] = '0';
     }
-    else if (flags & FLAGS_PLUS) {
-      buf[len++] = '+';  // ignore the space if the '+' exists
+    if (i) {
+      frac_digits[i - 1U]++;
     }
-    else if (flags & FLAGS_SPACE) {
-      buf[len++] = ' ';
+    else {
+      whole++;
     }
   }
 
-  return _out_rev(out, buffer, idx, maxlen, buf, len, width, flags);
+  return _fixed_out(out, buffer, idx, maxlen, digits, _fixed_digits(digits, whole), frac_digits, n, 0U, decimals - n, negative, width, flags);
 }
+#endif  // PRINTF_SUPPORT_FIXED_POINT
 
 
-#if defined(PRINTF_SUPPORT_EXPONENTIAL)
-// internal ftoa variant for exponential floating-point type, contributed by Martijn Jasperse <m.jasperse@gmail.com>
-static size_t _etoa(out_fct_type out, char* buffer, size_t idx, size_t maxlen, double value, unsigned int prec, unsigned int width, unsigned int flags)
-{
-  // check for NaN and special values
-  if ((value != value) || (value > DBL_MAX) || (value < -DBL_MAX)) {
-    return _ftoa(out, buffer, idx, maxlen, value, prec, width, flags);
-  }
+#if defined(PRINTF_SUPPORT_FLOAT)
 
-  // determine the sign
-  const bool negative = value < 0;
-  if (negative) {
-    value = -value;
-  }
+// exact decimal digits of a double with integer arithmetic only, no soft-float and no range
+// limit; the digits are numbered by position: 9 per group, starting with the most significant
+// group of the integer part, the fraction groups follow the integer groups
+// 10^(9*35) > 2^1024 holds any integer part in base 10^9 words, 32*34 >= 1074 bits any fraction
+#define FLOAT_DIGITS_WORDS  35U
+#define FLOAT_DIGITS_GROUP  1000000000U
+
+typedef struct {
+  uint32_t word[FLOAT_DIGITS_WORDS];  // least significant first: a large integer part in base 10^9,
+                                      // or the fraction word / 2^(32 * frac_words) in base 2^32
+  uint32_t whole[3];    // an integer part below 2^64 in base 10^9, most significant first
+  size_t   int_words;   // base 10^9 words of a larger integer part, 0 if 'whole' holds it
+  size_t   int_groups;  // groups of the integer part
+  size_t   frac_words;
+  size_t   lo, hi;      // the fraction words [lo, hi) can be non-zero
+  size_t   next;        // groups returned so far
+} float_digits_type;
+
+// digit generator with the current group as characters
+typedef struct {
+  float_digits_type digits;
+  char   group[9];
+  size_t end;           // position behind the digits in 'group'
+} float_cursor_type;
+
+// the digits kept by a conversion and how they round
+typedef struct {
+  char   digit[PRINTF_FTOA_BUFFER_SIZE];  // the rounded digits if 'buffered', longer conversions
+                                         // generate them again for the output
+  bool   buffered;
+  size_t start;         // position of the first digit
+  size_t count;         // number of digits
+  size_t last;          // the last digit that is not 9, SIZE_MAX if all are
+  size_t nonzero;       // number of digits up to the last non-zero one after rounding
+  int    exp10;         // decimal exponent of the first digit after rounding
+  bool   round_up;
+  bool   carry;         // rounding up carries out of all digits, they become 1000...
+} float_plan_type;
+
+
+// internal x / 10^9 with a reciprocal multiplication instead of __aeabi_uldivmod
+// x / 10^9 == ((x >> 9) * ceil(2^84 / 5^9)) >> 84, exact for any 64-bit x
+static inline uint64_t _float_div_group(uint64_t x)
+{
+  return _umulh64(x >> 9U, 0x89705F4136B4A598ULL) >> 20U;
+}
 
-  // default precision
-  if (!(flags & FLAGS_PRECISION)) {
-    prec = PRINTF_DEFAULT_FLOAT_PRECISION;
-  }
 
-  // determine the decimal exponent
-  // based on the algorithm by David Gay (https://www.ampl.com/netlib/fp/dtoa.c)
+// internal setup of the digit generator for a non-negative value
+static void _float_digits_init(float_digits_type* g, double value)
+{
   union {
     uint64_t U;
     double   F;
   } conv;
 
   conv.F = value;
-  int exp2 = (int)((conv.U >> 52U) & 0x07FFU) - 1023;           // effectively log2
-  conv.U = (conv.U & ((1ULL << 52U) - 1U)) | (1023ULL << 52U);  // drop the exponent so conv.F is now in [1,2)
-  // now approximate log10 from the log2 integer part and an expansion of ln around 1.5
-  int expval = (int)(0.1760912590558 + exp2 * 0.301029995663981 + (conv.F - 1.5) * 0.289529654602168);
-  // now we want to compute 10^expval but we want to be sure it won't overflow
-  exp2 = (int)(expval * 3.321928094887362 + 0.5);
-  const double z  = expval * 2.302585092994046 - exp2 * 0.6931471805599453;
-  const double z2 = z * z;
-  conv.U = (uint64_t)(exp2 + 1023) << 52U;
-  // compute exp(z) using continued fractions, see https://en.wikipedia.org/wiki/Exponential_function#Continued_fractions_for_ex
-  conv.F *= 1 + 2 * z / (2 - z + (z2 / (6 + (z2 / (10 + z2 / 14)))));
-  // correct for rounding errors
-  if (value < conv.F) {
-    expval--;
-    conv.F /= 10;
-  }
-
-  // the exponent format is "%+03d" and largest value is "307", so set aside 4-5 characters
-  unsigned int minwidth = ((expval < 100) && (expval > -100)) ? 4U : 5U;
+  const int E = (int)((conv.U >> 52U) & 0x07FFU);
+  uint64_t m  = conv.U & ((1ULL << 52U) - 1U);
+  int e2      = E ? (E - 1075) : -1074;
+  if (E) {
+    m |= 1ULL << 52U;
+  }
 
-  // in "%g" mode, "prec" is the number of *significant figures* not decimals
-  if (flags & FLAGS_ADAPT_EXP) {
-    // do we want to fall-back to "%f" mode?
-    if ((value >= 1e-4) && (value < 1e6)) {
-      if ((int)prec > expval) {
-        prec = (unsigned)((int)prec - expval - 1);
+  g->int_words  = 0U;
+  g->frac_words = 0U;
+  g->lo         = 0U;
+  g->hi         = 0U;
+  g->next       = 0U;
+
+  if (e2 > 11) {
+    // integer value m * 2^e2 of 2^64 or more in base 10^9, shifted by at most 29 bits per
+    // pass so that a word times 2^29 plus the carry fits 64 bits
+    size_t n = 0U;
+    do {
+      const uint64_t q = _float_div_group(m);
+      g->word[n++] = (uint32_t)(m - q * FLOAT_DIGITS_GROUP);
+      m = q;
+    } while (m);
+    while (e2 > 0) {
+      const unsigned int shift = (e2 > 29) ? 29U : (unsigned int)e2;
+      uint32_t carry = 0U;
+      for (size_t i = 0U; i < n; i++) {
+        const uint64_t t = ((uint64_t)g->word[i] << shift) + carry;
+        carry = (uint32_t)_float_div_group(t);
+        g->word[i] = (uint32_t)(t - (uint64_t)carry * FLOAT_DIGITS_GROUP);
       }
-      else {
-        prec = 0;
+      if (carry) {
+        g->word[n++] = carry;
       }
-      flags |= FLAGS_PRECISION;   // make sure _ftoa respects precision
-      // no characters in exponent
-      minwidth = 0U;
-      expval   = 0;
+      e2 -= (int)shift;
+    }
+    g->int_words  = n;
+    g->int_groups = n;
+    return;
+  }
+
+  // integer part below 2^64, fraction of s bits
+  const unsigned int s = (e2 < 0) ? (unsigned int)-e2 : 0U;
+  const uint64_t whole = (e2 >= 0) ? (m << e2) : (s < 64U) ? (m >> s) : 0U;
+  const uint64_t frac  = (e2 >= 0) ? 0U : (s < 64U) ? (m & ((1ULL << s) - 1U)) : m;
+  g->whole[0] = 0U;
+  g->whole[1] = 0U;
+  if (whole < FLOAT_DIGITS_GROUP) {
+    g->whole[2]   = (uint32_t)whole;
+    g->int_groups = 1U;
+  }
+  else {
+    const uint64_t q = _float_div_group(whole);
+    g->whole[2] = (uint32_t)(whole - q * FLOAT_DIGITS_GROUP);
+    if (q < FLOAT_DIGITS_GROUP) {
+      g->whole[1]   = (uint32_t)q;
+      g->int_groups = 2U;
     }
     else {
-      // we use one sigfig for the whole part
-      if ((prec > 0) && (flags & FLAGS_PRECISION)) {
-        --prec;
-      }
+      const uint64_t r = _float_div_group(q);
+      g->whole[0]   = (uint32_t)r;
+      g->whole[1]   = (uint32_t)(q - r * FLOAT_DIGITS_GROUP);
+      g->int_groups = 3U;
     }
   }
+  if (!s) {
+    return;
+  }
 
-  // will everything fit?
-  unsigned int fwidth = width;
-  if (width > minwidth) {
-    // we didn't fall-back so subtract the characters required for the exponent
-    fwidth -= minwidth;
-  } else {
-    // not enough characters, so go back to default sizing
-    fwidth = 0U;
+  // move the binary point to a word boundary, frac / 2^s == (frac << shift) / 2^(32 * frac_words)
+  g->frac_words = (s + 31U) / 32U;
+  const unsigned int shift = (unsigned int)(32U * g->frac_words - s);
+  g->word[0] = (uint32_t)(frac << shift);
+  g->word[1] = (uint32_t)((frac << shift) >> 32U);
+  g->word[2] = shift ? (uint32_t)(frac >> (64U - shift)) : 0U;
+  g->hi = (g->frac_words < 3U) ? g->frac_words : 3U;
+  while ((g->hi > g->lo) && !g->word[g->hi - 1U]) {
+    g->hi--;
+  }
+  while ((g->lo < g->hi) && !g->word[g->lo]) {
+    g->lo++;
   }
-  if ((flags & FLAGS_LEFT) && minwidth) {
-    // if we're padding on the right, DON'T pad the floating part
-    fwidth = 0U;
+}
+
+
+// internal group k of the integer part, 0 is the most significant
+static inline uint32_t _float_digits_int_group(const float_digits_type* g, size_t k)
+{
+  return g->int_words ? g->word[g->int_words - 1U - k] : g->whole[3U - g->int_groups + k];
+}
+
+
+// internal next group of 9 digits
+static uint32_t _float_digits_next(float_digits_type* g)
+{
+  const size_t k = g->next++;
+  if (k < g->int_groups) {
+    return _float_digits_int_group(g, k);
   }
 
-  // rescale the float value
-  if (expval) {
-    value /= conv.F;
+  // the next fraction digits are what fraction * 10^9 carries over the binary point
+  uint32_t carry = 0U;
+  for (size_t i = g->lo; i < g->hi; i++) {
+    const uint64_t t = (uint64_t)g->word[i] * FLOAT_DIGITS_GROUP + carry;
+    g->word[i] = (uint32_t)t;
+    carry = (uint32_t)(t >> 32U);
+  }
+  if (g->hi < g->frac_words) {
+    if (carry) {
+      g->word[g->hi++] = carry;
+    }
+    carry = 0U;
   }
+  while ((g->lo < g->hi) && !g->word[g->lo]) {
+    g->lo++;
+  }
+  return carry;
+}
 
-  // output the floating part
-  const size_t start_idx = idx;
-  idx = _ftoa(out, buffer, idx, maxlen, negative ? -value : value, prec, fwidth, flags & ~FLAGS_ADAPT_EXP);
 
-  // output the exponent part
-  if (minwidth) {
-    // output the exponential symbol
-    out((flags & FLAGS_UPPERCASE) ? 'E' : 'e', buffer, idx++, maxlen);
-    // output the exponent value
-    idx = _ntoa_long(out, buffer, idx, maxlen, (expval < 0) ? -expval : expval, expval < 0, 10, 0, minwidth-1, FLAGS_ZEROPAD | FLAGS_PLUS);
-    // might need to right-pad spaces
-    if (flags & FLAGS_LEFT) {
-      while (idx - start_idx < width) out(' ', buffer, idx++, maxlen);
+// internal test for non-zero digits behind the groups returned so far
+static bool _float_digits_rest(const float_digits_type* g)
+{
+  if (g->lo < g->hi) {
+    return true;
+  }
+  for (size_t k = g->next; k < g->int_groups; k++) {
+    if (_float_digits_int_group(g, k)) {
+      return true;
     }
   }
-  return idx;
+  return false;
 }
-#endif  // PRINTF_SUPPORT_EXPONENTIAL
-#endif  // PRINTF_SUPPORT_FLOAT
 
 
-// internal vsnprintf
-static int _vsnprintf(out_fct_type out, char* buffer, const size_t maxlen, const char* format, va_list va)
+static inline void _float_cursor_init(float_cursor_type* c, double value)
 {
-  unsigned int flags, width, precision, n;
-  size_t idx = 0U;
+  _float_digits_init(&c->digits, value);
+  c->end = 0U;
+}
 
-  if (!buffer) {
-    // use null output function
-    out = _out_null;
+
+// internal 9 digits of a group, with leading zeros
+static void _float_group_chars(char* buf, uint32_t group)
+{
+  buf[0] = (char)('0' + group / 100000000U);
+  group %= 100000000U;
+  for (size_t i = 8U; i > 0U; i -= 2U) {
+    const uint32_t pair = (group % 100U) * 2U;
+    group /= 100U;
+    buf[i - 1U] = _dec_digit_pairs[pair];
+    buf[i]      = _dec_digit_pairs[pair + 1U];
   }
+}
 
-  while (*format)
-  {
-    // format specifier?  %[flags][width][.precision][length]
-    if (*format != '%') {
-      // no
-      out(*format, buffer, idx++, maxlen);
-      format++;
-      continue;
+
+// internal digits from a position to the end of its group at c->end, the positions must not
+// decrease by more than the current group
+static const char* _float_cursor_at(float_cursor_type* c, size_t pos)
+{
+  while (pos >= c->end) {
+    _float_group_chars(c->group, _float_digits_next(&c->digits));
+    c->end += 9U;
+  }
+  return &c->group[pos + 9U - c->end];
+}
+
+
+// internal rounding of the planned digits on the first dropped digit 'next' and whether anything
+// non-zero follows it, exact ties round to even; 'digit' is the last kept digit, 'last' and
+// 'nonzero' the last kept digits that are not 9 and not 0, SIZE_MAX if there is none
+static void _float_round(float_plan_type* plan, bool fixed, size_t count, size_t last, size_t nonzero, char digit, char next, bool rest, int exp10)
+{
+  plan->last     = last;
+  plan->round_up = (next > '5') || ((next == '5') && (rest || ((digit - '0') & 1)));
+  plan->carry    = plan->round_up && (last == SIZE_MAX);
+  plan->count    = count + ((fixed && plan->carry) ? 1U : 0U);
+  plan->exp10    = exp10 + (plan->carry ? 1 : 0);
+  plan->nonzero  = plan->carry ? 1U : plan->round_up ? (last + 1U) : (nonzero == SIZE_MAX) ? 0U : (nonzero + 1U);
+
+  if (plan->buffered && plan->carry) {
+    plan->digit[0] = '1';
+    memset(&plan->digit[1], '0', plan->count - 1U);
+  }
+  else if (plan->buffered && plan->round_up) {
+    plan->digit[last]++;
+    memset(&plan->digit[last + 1U], '0', count - last - 1U);
+  }
+}
+
+
+// internal digits of a non-zero integer part below 2^64, at most 3 groups
+// \return The number of digits written to buf
+static size_t _float_whole_chars(char* buf, uint64_t whole)
+{
+  uint32_t groups[2];
+  char group[9];
+  size_t k = 0U, i = 0U;
+
+  while (whole >= FLOAT_DIGITS_GROUP) {
+    const uint64_t q = _float_div_group(whole);
+    groups[k++] = (uint32_t)(whole - q * FLOAT_DIGITS_GROUP);
+    whole = q;
+  }
+  _float_group_chars(group, (uint32_t)whole);
+  while (group[i] == '0') {
+    i++;
+  }
+  memcpy(buf, &group[i], 9U - i);
+  size_t n = 9U - i;
+  while (k) {
+    _float_group_chars(&buf[n], groups[--k]);
+    n += 9U;
+  }
+  return n;
+}
+
+
+// internal plan of %f with up to 8 decimals for a value below 2^64 with at most 64 fraction bits,
+// whole + f / 2^64: f * 10^(count + 1) / 2^64 holds the decimals and the next digit, they round
+// as one number
+static void _float_plan_fixed(float_plan_type* plan, uint64_t whole, uint64_t f, size_t count)
+{
+  static const uint32_t pow10[] = { 1U, 10U, 100U, 1000U, 10000U, 100000U, 1000000U, 10000000U, 100000000U, 1000000000U };
+  char group[9];
+
+  // 96-bit product, the top 32 bits are the digits, the rest decides a tie
+  const uint64_t lo = (uint64_t)(uint32_t)f * pow10[count + 1U];
+  const uint64_t hi = (f >> 32U) * pow10[count + 1U] + (lo >> 32U);
+  const uint32_t q = (uint32_t)(hi >> 32U);
+  const bool rest = ((uint32_t)hi != 0U) || ((uint32_t)lo != 0U);
+  uint32_t kept = q / 10U;
+  const bool odd = count ? (kept & 1U) : (whole & 1U);
+  if (((q % 10U) > 5U) || (((q % 10U) == 5U) && (rest || odd))) {
+    if (++kept == pow10[count]) {
+      kept = 0U;
+      whole++;
     }
-    else {
-      // yes, evaluate it
-      format++;
+  }
+
+  size_t n = 1U;
+  if (whole) {
+    n = _float_whole_chars(plan->digit, whole);
+  }
+  else {
+    plan->digit[0] = '0';
+  }
+  _float_group_chars(group, kept);
+  memcpy(&plan->digit[n], &group[9U - count], count);
+
+  plan->buffered = true;
+  plan->start    = 0U;
+  plan->count    = n + count;
+  plan->last     = SIZE_MAX;
+  plan->nonzero  = n + count;
+  plan->exp10    = (int)n - 1;
+  plan->round_up = false;
+  plan->carry    = false;
+}
+
+
+// internal plan of a value below 2^64 with at most 64 fraction bits, whole + f / 2^64, straight
+// into the digit buffer without the generator
+// \return false if the digits do not fit the buffer
+static bool _float_plan_short(float_plan_type* plan, uint64_t whole, uint64_t f, bool fixed, size_t count)
+{
+  char* const d = plan->digit;
+  char group[9];
+  size_t n = 0U;
+  int exp10 = -1;
+  bool rest = false;
+
+  if (whole) {
+    n = _float_whole_chars(d, whole);
+    exp10 = (int)n - 1;
+  }
+  else if (fixed || !f) {
+    d[n++] = '0';
+    exp10  = 0;
+  }
+
+  // the kept digits and the next one
+  const size_t need = (fixed ? n : 0U) + count + 1U;
+  if (need > sizeof(plan->digit)) {
+    return false;
+  }
+  for (size_t i = need; i < n; i++) {
+    rest = rest || (d[i] != '0');
+  }
+
+  // fraction digits, 9 at a time from f * 10^9; the zeros in front of the first significant one
+  // are skipped
+  bool significant = fixed || (n > 0U);
+  while (n < need) {
+    const uint64_t lo = (uint64_t)(uint32_t)f * FLOAT_DIGITS_GROUP;
+    const uint64_t hi = (f >> 32U) * FLOAT_DIGITS_GROUP + (lo >> 32U);
+    f = (hi << 32U) | (uint32_t)lo;
+    _float_group_chars(group, (uint32_t)(hi >> 32U));
+    size_t i = 0U;
+    if (!significant) {
+      while ((i < 9U) && (group[i] == '0')) {
+        i++;
+      }
+      exp10 -= (int)i;
+      significant = (i < 9U);
+    }
+    while ((i < 9U) && (n < need)) {
+      d[n++] = group[i++];
+    }
+    while ((i < 9U) && !rest) {
+      rest = (group[i++] != '0');
     }
+  }
+  rest = rest || f;
 
-    // evaluate flags
-    flags = 0U;
-    do {
-      switch (*format) {
-        case '0': flags |= FLAGS_ZEROPAD; format++; n = 1U; break;
-        case '-': flags |= FLAGS_LEFT;    format++; n = 1U; break;
-        case '+': flags |= FLAGS_PLUS;    format++; n = 1U; break;
-        case ' ': flags |= FLAGS_SPACE;   format++; n = 1U; break;
-        case '#': flags |= FLAGS_HASH;    format++; n = 1U; break;
-        default :                                   n = 0U; break;
-      }
-    } while (n);
-
-    // evaluate width field
-    width = 0U;
-    if (_is_digit(*format)) {
-      width = _atoi(&format);
+  size_t kept = need - 1U, last = SIZE_MAX, nonzero = SIZE_MAX;
+  for (size_t i = kept; i > 0U; i--) {
+    if (d[i - 1U] != '9') {
+      last = i - 1U;
+      break;
     }
-    else if (*format == '*') {
-      const int w = va_arg(va, int);
-      if (w < 0) {
-        flags |= FLAGS_LEFT;    // reverse padding
-        width = (unsigned int)-w;
+  }
+  for (size_t i = kept; i > 0U; i--) {
+    if (d[i - 1U] != '0') {
+      nonzero = i - 1U;
+      break;
+    }
+  }
+  plan->buffered = true;
+  plan->start    = 0U;
+  _float_round(plan, fixed, kept, last, nonzero, d[kept - 1U], d[kept], rest, exp10);
+  return true;
+}
+
+
+// internal rounding of a non-negative value, 'count' digits from the first significant one,
+// or with 'fixed' the integer digits and 'count' fraction digits; exact ties round to even
+static void _float_plan(float_plan_type* plan, double value, bool fixed, size_t count)
+{
+  union {
+    uint64_t U;
+    double   F;
+  } conv;
+
+  conv.F = value;
+  const int E = (int)((conv.U >> 52U) & 0x07FFU);
+  const uint64_t m = (conv.U & ((1ULL << 52U) - 1U)) | (E ? (1ULL << 52U) : 0U);
+  const int e2 = E ? (E - 1075) : -1074;
+  if ((e2 >= -64) && (e2 <= 11)) {
+    const uint64_t whole = (e2 >= 0) ? (m << e2) : (e2 > -64) ? (m >> -e2) : 0U;
+    const uint64_t f     = (e2 >= 0) ? 0U : (e2 > -64) ? (m << (64 + e2)) : m;
+    if (fixed && (count < 9U)) {
+      _float_plan_fixed(plan, whole, f, count);
+      return;
+    }
+    if (_float_plan_short(plan, whole, f, fixed, count)) {
+      return;
+    }
+  }
+
+  float_cursor_type c;
+  _float_cursor_init(&c, value);
+  const size_t int_end = 9U * c.digits.int_groups;
+
+  // first integer digit, the last one of the group if the integer part is 0
+  const char* digits = _float_cursor_at(&c, 0U);
+  size_t start = 0U;
+  while ((start < 8U) && (*digits == '0')) {
+    start++;
+    digits++;
+  }
+  if (fixed) {
+    count += int_end - start;
+  }
+  else if (value != 0.0) {
+    while (*digits == '0') {
+      start++;
+      digits = (start < c.end) ? (digits + 1) : _float_cursor_at(&c, start);
+    }
+  }
+
+  // the digits are kept if they fit with a carry, taken a group at a time
+  const size_t end = start + count;
+  size_t last = SIZE_MAX, nonzero = SIZE_MAX;
+  char digit = '0';
+  plan->buffered = (count < sizeof(plan->digit));
+  for (size_t pos = start; pos < end;) {
+    const char* chunk = _float_cursor_at(&c, pos);
+    const size_t n = ((end < c.end) ? end : c.end) - pos;
+    if (plan->buffered) {
+      memcpy(&plan->digit[pos - start], chunk, n);
+    }
+    for (size_t i = n; i > 0U; i--) {
+      if (chunk[i - 1U] != '9') {
+        last = pos - start + i - 1U;
+        break;
       }
-      else {
-        width = (unsigned int)w;
+    }
+    for (size_t i = n; i > 0U; i--) {
+      if (chunk[i - 1U] != '0') {
+        nonzero = pos - start + i - 1U;
+        break;
       }
-      format++;
     }
+    digit = chunk[n - 1U];
+    pos  += n;
+  }
 
-    // evaluate precision field
-    precision = 0U;
-    if (*format == '.') {
-      flags |= FLAGS_PRECISION;
-      format++;
-      if (_is_digit(*format)) {
-        precision = _atoi(&format);
-      }
-      else if (*format == '*') {
-        const int prec = (int)va_arg(va, int);
-        precision = prec > 0 ? (unsigned int)prec : 0U;
-        format++;
+  // the first dropped digit and whether anything follows it decide
+  const char next = *_float_cursor_at(&c, end);
+  bool rest = _float_digits_rest(&c.digits);
+  for (size_t i = end + 10U - c.end; (i < 9U) && !rest; i++) {
+    rest = (c.group[i] != '0');
+  }
+
+  plan->start = start;
+  _float_round(plan, fixed, count, last, nonzero, digit, next, rest, (int)int_end - 1 - (int)start);
+}
+
+
+// internal output of the rounded digits [from, to) of a plan that did not keep them
+static size_t _float_out_digits(const out_sink_type* out, char* buffer, size_t idx, size_t maxlen, float_cursor_type* c, const float_plan_type* plan, size_t from, size_t to)
+{
+  char chunk[16];
+  size_t n = 0U;
+
+  for (size_t i = from; i < to; i++) {
+    char digit;
+    if (plan->carry) {
+      digit = i ? '0' : '1';
+    }
+    else {
+      digit = *_float_cursor_at(c, plan->start + i);
+      if (plan->round_up && (i >= plan->last)) {
+        digit = (i == plan->last) ? (char)(digit + 1) : '0';
       }
     }
+    chunk[n++] = digit;
+    if (n == sizeof(chunk)) {
+      idx = _out_span(out, buffer, idx, maxlen, chunk, n);
+      n = 0U;
+    }
+  }
+  return _out_span(out, buffer, idx, maxlen, chunk, n);
+}
+
+
+// internal output of a float conversion: the sign, the integer digits [0, int_end) or "0" if
+// int_end is 0, the decimal point, 'zeros' zeros, the fraction digits [int_end, frac_end) and
+// the exponent suffix, padded to 'width'
+static size_t _float_out(const out_sink_type* out, char* buffer, size_t idx, size_t maxlen, double value, const float_plan_type* plan, size_t int_end, size_t zeros, size_t frac_end, bool point, const char* suffix, size_t suffix_len, bool negative, unsigned int width, unsigned int flags)
+{
+  const char sign = negative ? '-' : (flags & FLAGS_PLUS) ? '+' : (flags & FLAGS_SPACE) ? ' ' : '\0';
+  const size_t len = (sign ? 1U : 0U) + (int_end ? int_end : 1U) + (point ? 1U : 0U) + zeros + (frac_end - int_end) + suffix_len;
+  const size_t pad = (len < width) ? width - len : 0U;
+
+  if (!(flags & FLAGS_LEFT) && !(flags & FLAGS_ZEROPAD)) {
+    idx = _out_fill(out, buffer, idx, maxlen, ' ', pad);
+  }
+  if (sign) {
+    idx = _out_span(out, buffer, idx, maxlen, &sign, 1U);
+  }
+  if (!(flags & FLAGS_LEFT) && (flags & FLAGS_ZEROPAD)) {
+    idx = _out_fill(out, buffer, idx, maxlen, '0', pad);
+  }
+
+  if (plan->buffered) {
+    // the kept digits, at most 3 zeros of %g and the suffix in one piece
+    char text[PRINTF_FTOA_BUFFER_SIZE + 16U];
+    size_t n = 0U;
+    if (int_end) {
+      memcpy(text, plan->digit, int_end);
+      n = int_end;
+    }
+    else {
+      text[n++] = '0';
+    }
+    if (point) {
+      text[n++] = '.';
+    }
+    memset(&text[n], '0', zeros);
+    n += zeros;
+    memcpy(&text[n], &plan->digit[int_end], frac_end - int_end);
+    n += frac_end - int_end;
+    memcpy(&text[n], suffix, suffix_len);
+    idx = _out_span(out, buffer, idx, maxlen, text, n + suffix_len);
+  }
+  else {
+    float_cursor_type c;
+    _float_cursor_init(&c, value);
+    if (int_end) {
+      idx = _float_out_digits(out, buffer, idx, maxlen, &c, plan, 0U, int_end);
+    }
+    else {
+      idx = _out_fill(out, buffer, idx, maxlen, '0', 1U);
+    }
+    if (point) {
+      idx = _out_fill(out, buffer, idx, maxlen, '.', 1U);
+    }
+    idx = _out_fill(out, buffer, idx, maxlen, '0', zeros);
+    idx = _float_out_digits(out, buffer, idx, maxlen, &c, plan, int_end, frac_end);
+    idx = _out_span(out, buffer, idx, maxlen, suffix, suffix_len);
+  }
+
+  if (flags & FLAGS_LEFT) {
+    idx = _out_fill(out, buffer, idx, maxlen, ' ', pad);
+  }
+  return idx;
+}
+
+
+// internal ftoa for fixed decimal floating point
+static size_t _ftoa(const out_sink_type* out, char* buffer, size_t idx, size_t maxlen, double value, unsigned int prec, unsigned int width, unsigned int flags)
+{
+  // test for special values
+  if (value != value)
+    return _out_rev(out, buffer, idx, maxlen, "nan", 3, width, flags);
+  if (value < -DBL_MAX)
+    return _out_rev(out, buffer, idx, maxlen, "fni-", 4, width, flags);
+  if (value > DBL_MAX)
+    return _out_rev(out, buffer, idx, maxlen, (flags & FLAGS_PLUS) ? "fni+" : "fni", (flags & FLAGS_PLUS) ? 4U : 3U, width, flags);
+
+  // the sign bit, -0.0 prints as -0
+  const bool negative = signbit(value);
+  if (negative) {
+    value = -value;
+  }
+
+  // set default precision, if not set explicitly
+  if (!(flags & FLAGS_PRECISION)) {
+    prec = PRINTF_DEFAULT_FLOAT_PRECISION;
+  }
+
+  float_plan_type plan;
+  _float_plan(&plan, value, true, prec);
+  const size_t int_end = (size_t)plan.exp10 + 1U;
+  return _float_out(out, buffer, idx, maxlen, value, &plan, int_end, 0U, plan.count, prec || (flags & FLAGS_HASH), "", 0U, negative, width, flags);
+}
+
+
+#if defined(PRINTF_SUPPORT_EXPONENTIAL)
+// internal etoa for exponential floating point, and %g with a precision
+static size_t _etoa(const out_sink_type* out, char* buffer, size_t idx, size_t maxlen, double value, unsigned int prec, unsigned int width, unsigned int flags)
+{
+  // check for NaN and special values
+  if ((value != value) || (value > DBL_MAX) || (value < -DBL_MAX)) {
+    return _ftoa(out, buffer, idx, maxlen, value, prec, width, flags);
+  }
+
+  const bool negative = signbit(value);
+  if (negative) {
+    value = -value;
+  }
+
+  // default precision
+  if (!(flags & FLAGS_PRECISION)) {
+    prec = PRINTF_DEFAULT_FLOAT_PRECISION;
+  }
+
+  // in "%g" mode, "prec" is the number of *significant figures* not decimals
+  const bool adapt = (flags & FLAGS_ADAPT_EXP) != 0U;
+  const size_t digits = adapt ? (prec ? prec : 1U) : (size_t)prec + 1U;
+
+  float_plan_type plan;
+  _float_plan(&plan, value, false, digits);
+  const int x = plan.exp10;
+
+  // %g drops the trailing zeros, unless '#'
+  size_t count = plan.count;
+  if (adapt && !(flags & FLAGS_HASH)) {
+    count = plan.nonzero ? plan.nonzero : 1U;
+  }
+
+  // %g falls back to "%f" style for exponents -4 <= x < precision
+  if (adapt && (x >= -4) && (x < (int)digits)) {
+    if (x < 0) {
+      return _float_out(out, buffer, idx, maxlen, value, &plan, 0U, (size_t)(-x - 1), count, true, "", 0U, negative, width, flags);
+    }
+    const size_t int_end  = (size_t)x + 1U;
+    const size_t frac_end = (count > int_end) ? count : int_end;
+    return _float_out(out, buffer, idx, maxlen, value, &plan, int_end, 0U, frac_end, (frac_end > int_end) || (flags & FLAGS_HASH), "", 0U, negative, width, flags);
+  }
+
+  // the exponent has at least two digits
+  char suffix[5];
+  size_t suffix_len = 0U;
+  const unsigned int e = (unsigned int)((x < 0) ? -x : x);
+  suffix[suffix_len++] = (flags & FLAGS_UPPERCASE) ? 'E' : 'e';
+  suffix[suffix_len++] = (x < 0) ? '-' : '+';
+  if (e >= 100U) {
+    suffix[suffix_len++] = (char)('0' + e / 100U);
+  }
+  suffix[suffix_len++] = _dec_digit_pairs[(e % 100U) * 2U];
+  suffix[suffix_len++] = _dec_digit_pairs[(e % 100U) * 2U + 1U];
 
-    // evaluate length field
+  return _float_out(out, buffer, idx, maxlen, value, &plan, 1U, 0U, count, (count > 1U) || (flags & FLAGS_HASH), suffix, suffix_len, negative, width, flags);
+}
+
+#if defined(PRINTF_SUPPORT_SHORTEST_FLOAT)
+// shortest round trip conversion, Grisu2 by Florian Loitsch ("Printing Floating-Point
+// Numbers Quickly and Accurately with Integers", PLDI 2010), the digit generation
+// follows the nlohmann/json implementation; integer arithmetic only
+
+// "do it yourself" floating point, f * 2^e
+typedef struct {
+  uint64_t f;
+  int      e;
+} diyfp_type;
+
+// cached power of ten, 10^k ~= f * 2^e
+typedef struct {
+  uint64_t f;
+  int16_t  e;
+  int16_t  k;
+} cached_power_type;
+
+#define GRISU_ALPHA                   (-60)
+#define GRISU_GAMMA                   (-32)
+#define GRISU_CACHED_POWERS_MIN_K     (-300)
+#define GRISU_CACHED_POWERS_STEP_K    8
+
+// 10^k for k = -300, -292, ..., 324, rounded to 64 bits
+static const cached_power_type _cached_powers[] = {
+  { 0xAB70FE17C79AC6CAULL, -1060, -300 },
+  { 0xFF77B1FCBEBCDC4FULL, -1034, -292 },
+  { 0xBE5691EF416BD60CULL, -1007, -284 },
+  { 0x8DD01FAD907FFC3CULL,  -980, -276 },
+  { 0xD3515C2831559A83ULL,  -954, -268 },
+  { 0x9D71AC8FADA6C9B5ULL,  -927, -260 },
+  { 0xEA9C227723EE8BCBULL,  -901, -252 },
+  { 0xAECC49914078536DULL,  -874, -244 },
+  { 0x823C12795DB6CE57ULL,  -847, -236 },
+  { 0xC21094364DFB5637ULL,  -821, -228 },
+  { 0x9096EA6F3848984FULL,  -794, -220 },
+  { 0xD77485CB25823AC7ULL,  -768, -212 },
+  { 0xA086CFCD97BF97F4ULL,  -741, -204 },
+  { 0xEF340A98172AACE5ULL,  -715, -196 },
+  { 0xB23867FB2A35B28EULL,  -688, -188 },
+  { 0x84C8D4DFD2C63F3BULL,  -661, -180 },
+  { 0xC5DD44271AD3CDBAULL,  -635, -172 },
+  { 0x936B9FCEBB25C996ULL,  -608, -164 },
+  { 0xDBAC6C247D62A584ULL,  -582, -156 },
+  { 0xA3AB66580D5FDAF6ULL,  -555, -148 },
+  { 0xF3E2F893DEC3F126ULL,  -529, -140 },
+  { 0xB5B5ADA8AAFF80B8ULL,  -502, -132 },
+  { 0x87625F056C7C4A8BULL,  -475, -124 },
+  { 0xC9BCFF6034C13053ULL,  -449, -116 },
+  { 0x964E858C91BA2655ULL,  -422, -108 },
+  { 0xDFF9772470297EBDULL,  -396, -100 },
+  { 0xA6DFBD9FB8E5B88FULL,  -369,  -92 },
+  { 0xF8A95FCF88747D94ULL,  -343,  -84 },
+  { 0xB94470938FA89BCFULL,  -316,  -76 },
+  { 0x8A08F0F8BF0F156BULL,  -289,  -68 },
+  { 0xCDB02555653131B6ULL,  -263,  -60 },
+  { 0x993FE2C6D07B7FACULL,  -236,  -52 },
+  { 0xE45C10C42A2B3B06ULL,  -210,  -44 },
+  { 0xAA242499697392D3ULL,  -183,  -36 },
+  { 0xFD87B5F28300CA0EULL,  -157,  -28 },
+  { 0xBCE5086492111AEBULL,  -130,  -20 },
+  { 0x8CBCCC096F5088CCULL,  -103,  -12 },
+  { 0xD1B71758E219652CULL,   -77,   -4 },
+  { 0x9C40000000000000ULL,   -50,    4 },
+  { 0xE8D4A51000000000ULL,   -24,   12 },
+  { 0xAD78EBC5AC620000ULL,     3,   20 },
+  { 0x813F3978F8940984ULL,    30,   28 },
+  { 0xC097CE7BC90715B3ULL,    56,   36 },
+  { 0x8F7E32CE7BEA5C70ULL,    83,   44 },
+  { 0xD5D238A4ABE98068ULL,   109,   52 },
+  { 0x9F4F2726179A2245ULL,   136,   60 },
+  { 0xED63A231D4C4FB27ULL,   162,   68 },
+  { 0xB0DE65388CC8ADA8ULL,   189,   76 },
+  { 0x83C7088E1AAB65DBULL,   216,   84 },
+  { 0xC45D1DF942711D9AULL,   242,   92 },
+  { 0x924D692CA61BE758ULL,   269,  100 },
+  { 0xDA01EE641A708DEAULL,   295,  108 },
+  { 0xA26DA3999AEF774AULL,   322,  116 },
+  { 0xF209787BB47D6B85ULL,   348,  124 },
+  { 0xB454E4A179DD1877ULL,   375,  132 },
+  { 0x865B86925B9BC5C2ULL,   402,  140 },
+  { 0xC83553C5C8965D3DULL,   428,  148 },
+  { 0x952AB45CFA97A0B3ULL,   455,  156 },
+  { 0xDE469FBD99A05FE3ULL,   481,  164 },
+  { 0xA59BC234DB398C25ULL,   508,  172 },
+  { 0xF6C69A72A3989F5CULL,   534,  180 },
+  { 0xB7DCBF5354E9BECEULL,   561,  188 },
+  { 0x88FCF317F22241E2ULL,   588,  196 },
+  { 0xCC20CE9BD35C78A5ULL,   614,  204 },
+  { 0x98165AF37B2153DFULL,   641,  212 },
+  { 0xE2A0B5DC971F303AULL,   667,  220 },
+  { 0xA8D9D1535CE3B396ULL,   694,  228 },
+  { 0xFB9B7CD9A4A7443CULL,   720,  236 },
+  { 0xBB764C4CA7A44410ULL,   747,  244 },
+  { 0x8BAB8EEFB6409C1AULL,   774,  252 },
+  { 0xD01FEF10A657842CULL,   800,  260 },
+  { 0x9B10A4E5E9913129ULL,   827,  268 },
+  { 0xE7109BFBA19C0C9DULL,   853,  276 },
+  { 0xAC2820D9623BF429ULL,   880,  284 },
+  { 0x80444B5E7AA7CF85ULL,   907,  292 },
+  { 0xBF21E44003ACDD2DULL,   933,  300 },
+  { 0x8E679C2F5E44FF8FULL,   960,  308 },
+  { 0xD433179D9C8CB841ULL,   986,  316 },
+  { 0x9E19DB92B4E31BA9ULL,  1013,  324 }
+};
+
+
+// internal diyfp product, the high 64 bits rounded
+static diyfp_type _diyfp_mul(diyfp_type x, diyfp_type y)
+{
+  const uint64_t p0 = (uint64_t)(uint32_t)x.f * (uint32_t)y.f;
+  const uint64_t p1 = (uint64_t)(uint32_t)x.f * (uint32_t)(y.f >> 32U);
+  const uint64_t p2 = (uint64_t)(uint32_t)(x.f >> 32U) * (uint32_t)y.f;
+  const uint64_t p3 = (uint64_t)(uint32_t)(x.f >> 32U) * (uint32_t)(y.f >> 32U);
+  uint64_t q = (p0 >> 32U) + (uint32_t)p1 + (uint32_t)p2;
+  q += 1ULL << 31U;   // round
+  const diyfp_type r = { p3 + (p1 >> 32U) + (p2 >> 32U) + (q >> 32U), x.e + y.e + 64 };
+  return r;
+}
+
+
+// internal diyfp normalization, shifts the highest set bit to bit 63
+static diyfp_type _diyfp_normalize(diyfp_type x)
+{
+  while (!(x.f >> 63U)) {
+    x.f <<= 1U;
+    x.e--;
+  }
+  return x;
+}
+
+
+// internal Grisu2 rounding, moves the last digit closer to the exact value
+static void _grisu2_round(char* buf, size_t len, uint64_t dist, uint64_t delta, uint64_t rest, uint64_t ten_k)
+{
+  while ((rest < dist) && (delta - rest >= ten_k) && ((rest + ten_k < dist) || (dist - rest > rest + ten_k - dist))) {
+    buf[len - 1U]--;
+    rest += ten_k;
+  }
+}
+
+
+// internal Grisu2 digit generation for M- < w < M+, all scaled to the exponent range [alpha, gamma]
+// \return The number of digits written to buf, the value is buf * 10^decimal_exponent
+static size_t _grisu2_digit_gen(char* buf, int* decimal_exponent, diyfp_type m_minus, diyfp_type w, diyfp_type m_plus)
+{
+  static const uint32_t pow10[] = { 1U, 10U, 100U, 1000U, 10000U, 100000U, 1000000U, 10000000U, 100000000U, 1000000000U };
+  uint64_t delta = m_plus.f - m_minus.f;
+  uint64_t dist  = m_plus.f - w.f;
+  const unsigned int shift = (unsigned int)-m_plus.e;
+  const uint64_t one_f = 1ULL << shift;
+  size_t len = 0U;
+
+  // integral part, p1 fits 32 bits as -e >= 32
+  uint32_t p1 = (uint32_t)(m_plus.f >> shift);
+  uint64_t p2 = m_plus.f & (one_f - 1U);
+
+  int n = 1;
+  while ((n < 10) && (p1 >= pow10[n])) {
+    n++;
+  }
+  while (n > 0) {
+    const uint32_t p = pow10[--n];
+    buf[len++] = (char)('0' + p1 / p);
+    p1 %= p;
+    const uint64_t rest = ((uint64_t)p1 << shift) + p2;
+    if (rest <= delta) {
+      *decimal_exponent += n;
+      _grisu2_round(buf, len, dist, delta, rest, (uint64_t)p << shift);
+      return len;
+    }
+  }
+
+  // fractional part
+  int m = 0;
+  do {
+    p2 *= 10U;
+    buf[len++] = (char)('0' + (p2 >> shift));
+    p2 &= one_f - 1U;
+    m++;
+    delta *= 10U;
+    dist  *= 10U;
+  } while (p2 > delta);
+  *decimal_exponent -= m;
+  _grisu2_round(buf, len, dist, delta, p2, one_f);
+  return len;
+}
+
+
+// internal Grisu2 for the significand F and biased exponent E of an IEEE binary format
+// with 'digits' significand bits (hidden bit included) and exponent 'bias'
+// \return The number of digits written to buf, the value is buf * 10^decimal_exponent
+static size_t _grisu2(char* buf, int* decimal_exponent, uint64_t F, int E, unsigned int digits, int bias)
+{
+  const uint64_t hidden_bit = 1ULL << (digits - 1U);
+  const diyfp_type v = E ? (diyfp_type){ F + hidden_bit, E - bias } : (diyfp_type){ F, 1 - bias };
+
+  // boundaries halfway to the neighbours, the lower one is closer at a power of 2
+  const diyfp_type m_plus  = _diyfp_normalize((diyfp_type){ (v.f << 1U) + 1U, v.e - 1 });
+  diyfp_type m_minus = ((F == 0U) && (E > 1)) ? (diyfp_type){ (v.f << 2U) - 1U, v.e - 2 } : (diyfp_type){ (v.f << 1U) - 1U, v.e - 1 };
+  m_minus.f <<= (unsigned int)(m_minus.e - m_plus.e);
+  m_minus.e = m_plus.e;
+
+  // cached power c ~= 10^-k, that scales m_plus into [alpha, gamma]
+  const int f = GRISU_ALPHA - m_plus.e - 1;
+  const int k = (f * 78913) / (1 << 18) + (f > 0);
+  const cached_power_type* cached = &_cached_powers[(-GRISU_CACHED_POWERS_MIN_K + k + (GRISU_CACHED_POWERS_STEP_K - 1)) / GRISU_CACHED_POWERS_STEP_K];
+  const diyfp_type c = { cached->f, cached->e };
+
+  const diyfp_type w       = _diyfp_mul(_diyfp_normalize(v), c);
+  const diyfp_type w_minus = _diyfp_mul(m_minus, c);
+  const diyfp_type w_plus  = _diyfp_mul(m_plus, c);
+
+  // narrow the interval by the 1 ulp error of the products
+  *decimal_exponent = -cached->k;
+  return _grisu2_digit_gen(buf, decimal_exponent, (diyfp_type){ w_minus.f + 1U, w_minus.e }, w, (diyfp_type){ w_plus.f - 1U, w_plus.e });
+}
+
+
+// internal %g without precision and without '#': the shortest digits that read back as the same value
+// %hg takes a float argument (promoted to double) and prints the shortest digits of the
+// float, so 0.1f prints as 0.1 and not 0.100000001490116
+// notation as %g with the precision of max(digits, PRINTF_DEFAULT_FLOAT_PRECISION)
+static size_t _gtoa_shortest(const out_sink_type* out, char* buffer, size_t idx, size_t maxlen, double value, unsigned int width, unsigned int flags)
+{
+  union {
+    uint64_t U;
+    double   F;
+  } conv;
+  char digits[17];
+  char buf[PRINTF_FTOA_BUFFER_SIZE];
+  size_t n, len = 0U;
+  int k = 0;
+
+  conv.F = value;
+  const bool negative = conv.U >> 63U;
+  const int E = (int)((conv.U >> 52U) & 0x07FFU);
+  const uint64_t F = conv.U & ((1ULL << 52U) - 1U);
+
+  // NaN and infinity
+  if (E == 0x07FF) {
+    return _ftoa(out, buffer, idx, maxlen, value, 0U, width, flags);
+  }
+
+  if (!E && !F) {
+    digits[0] = '0';
+    n = 1U;
+  }
+  else if ((flags & FLAGS_SHORT) && (E >= 1023 - 126) && (E <= 1023 + 127) && !(F & ((1ULL << 29U) - 1U))) {
+    // a normal float, float denormals take the double path
+    n = _grisu2(digits, &k, F >> 29U, E - 1023 + 127, 24U, 127 + 23);
+  }
+  else {
+    n = _grisu2(digits, &k, F, E, 53U, 1023 + 52);
+  }
+
+  // decimal exponent of the first digit
+  const int x = (int)n + k - 1;
+  const int p = ((int)n > (int)PRINTF_DEFAULT_FLOAT_PRECISION) ? (int)n : (int)PRINTF_DEFAULT_FLOAT_PRECISION;
+
+  if (negative) {
+    buf[len++] = '-';
+  }
+  else if (flags & FLAGS_PLUS) {
+    buf[len++] = '+';  // ignore the space if the '+' exists
+  }
+  else if (flags & FLAGS_SPACE) {
+    buf[len++] = ' ';
+  }
+  const size_t sign_len = len;
+
+  if ((x < -4) || (x >= p)) {
+    // d.ddde+xx
+    buf[len++] = digits[0];
+    if (n > 1U) {
+      buf[len++] = '.';
+      memcpy(&buf[len], &digits[1], n - 1U);
+      len += n - 1U;
+    }
+    buf[len++] = (flags & FLAGS_UPPERCASE) ? 'E' : 'e';
+    buf[len++] = (x < 0) ? '-' : '+';
+    const unsigned int e = (unsigned int)((x < 0) ? -x : x);
+    if (e >= 100U) {
+      buf[len++] = (char)('0' + e / 100U);
+    }
+    buf[len++] = (char)('0' + (e / 10U) % 10U);
+    buf[len++] = (char)('0' + e % 10U);
+  }
+  else if (x >= 0) {
+    // ddd.ddd, the digits fill at least the integral part as x < p
+    const size_t whole = (size_t)x + 1U;
+    for (size_t i = 0U; i < whole; i++) {
+      buf[len++] = (i < n) ? digits[i] : '0';
+    }
+    if (n > whole) {
+      buf[len++] = '.';
+      memcpy(&buf[len], &digits[whole], n - whole);
+      len += n - whole;
+    }
+  }
+  else {
+    // 0.000ddd
+    buf[len++] = '0';
+    buf[len++] = '.';
+    for (int i = -1; i > x; i--) {
+      buf[len++] = '0';
+    }
+    memcpy(&buf[len], digits, n);
+    len += n;
+  }
+
+  // pad up to the given width, zeros go behind the sign
+  const size_t pad = (len < width) ? width - len : 0U;
+  if (flags & FLAGS_LEFT) {
+    idx = _out_span(out, buffer, idx, maxlen, buf, len);
+    return _out_fill(out, buffer, idx, maxlen, ' ', pad);
+  }
+  if (flags & FLAGS_ZEROPAD) {
+    idx = _out_span(out, buffer, idx, maxlen, buf, sign_len);
+    idx = _out_fill(out, buffer, idx, maxlen, '0', pad);
+    return _out_span(out, buffer, idx, maxlen, &buf[sign_len], len - sign_len);
+  }
+  idx = _out_fill(out, buffer, idx, maxlen, ' ', pad);
+  return _out_span(out, buffer, idx, maxlen, buf, len);
+}
+#endif  // PRINTF_SUPPORT_SHORTEST_FLOAT
+#endif  // PRINTF_SUPPORT_EXPONENTIAL
+#endif  // PRINTF_SUPPORT_FLOAT
+
+
+// internal format specifier parser, format points behind the '%'
+// '*' width and precision are only marked in the flags, their arguments are
+// fetched by _out_specifier
+// \return Pointer behind the conversion, NULL if the format ends inside it
+static const char* _parse_specifier(const char* format, char* specifier_out, unsigned int* flags_out, unsigned int* width_out, unsigned int* precision_out, unsigned int* fraction_out)
+{
+  unsigned int flags, width, precision, n;
+
+  // evaluate flags
+  flags = 0U;
+  do {
     switch (*format) {
-      case 'l' :
-        flags |= FLAGS_LONG;
+      case '0': flags |= FLAGS_ZEROPAD; format++; n = 1U; break;
+      case '-': flags |= FLAGS_LEFT;    format++; n = 1U; break;
+      case '+': flags |= FLAGS_PLUS;    format++; n = 1U; break;
+      case ' ': flags |= FLAGS_SPACE;   format++; n = 1U; break;
+      case '#': flags |= FLAGS_HASH;    format++; n = 1U; break;
+      default :                                   n = 0U; break;
+    }
+  } while (n);
+
+  // evaluate width field
+  width = 0U;
+  if (_is_digit(*format)) {
+    width = _atoi(&format);
+  }
+  else if (*format == '*') {
+    flags |= FLAGS_WIDTH_ARG;
+    format++;
+  }
+
+  // evaluate precision field
+  precision = 0U;
+  if (*format == '.') {
+    flags |= FLAGS_PRECISION;
+    format++;
+    if (_is_digit(*format)) {
+      precision = _atoi(&format);
+    }
+    else if (*format == '*') {
+      flags |= FLAGS_PRECISION_ARG;
+      format++;
+    }
+  }
+
+  // evaluate length field
+  switch (*format) {
+    case 'l' :
+      flags |= FLAGS_LONG;
+      format++;
+      if (*format == 'l') {
+        flags |= FLAGS_LONG_LONG;
         format++;
-        if (*format == 'l') {
-          flags |= FLAGS_LONG_LONG;
-          format++;
-        }
-        break;
-      case 'h' :
-        flags |= FLAGS_SHORT;
+      }
+      break;
+    case 'h' :
+      flags |= FLAGS_SHORT;
+      format++;
+      if (*format == 'h') {
+        flags |= FLAGS_CHAR;
         format++;
-        if (*format == 'h') {
-          flags |= FLAGS_CHAR;
-          format++;
-        }
-        break;
+      }
+      break;
 #if defined(PRINTF_SUPPORT_PTRDIFF_T)
-      case 't' :
-        flags |= (sizeof(ptrdiff_t) == sizeof(long) ? FLAGS_LONG : FLAGS_LONG_LONG);
-        format++;
-        break;
+    case 't' :
+      flags |= (sizeof(ptrdiff_t) == sizeof(long) ? FLAGS_LONG : FLAGS_LONG_LONG);
+      format++;
+      break;
 #endif
-      case 'j' :
-        flags |= (sizeof(intmax_t) == sizeof(long) ? FLAGS_LONG : FLAGS_LONG_LONG);
-        format++;
-        break;
-      case 'z' :
-        flags |= (sizeof(size_t) == sizeof(long) ? FLAGS_LONG : FLAGS_LONG_LONG);
-        format++;
-        break;
-      default :
-        break;
+    case 'j' :
+      flags |= (sizeof(intmax_t) == sizeof(long) ? FLAGS_LONG : FLAGS_LONG_LONG);
+      format++;
+      break;
+    case 'z' :
+      flags |= (sizeof(size_t) == sizeof(long) ? FLAGS_LONG : FLAGS_LONG_LONG);
+      format++;
+      break;
+    default :
+      break;
+  }
+
+  // evaluate specifier, the fixed point one is followed by the number of fraction bits
+  *specifier_out = *format;
+  *fraction_out  = PRINTF_DEFAULT_FRACTION_BITS;
+  if (!*format) {
+    return NULL;
+  }
+  format++;
+#if defined(PRINTF_SUPPORT_FIXED_POINT)
+  if ((*specifier_out == 'q') && _is_digit(*format)) {
+    *fraction_out = _atoi(&format);
+  }
+#endif
+
+  *flags_out     = flags;
+  *width_out     = width;
+  *precision_out = precision;
+  return format;
+}
+
+
+// internal output of one conversion
+// \return The index following the output
+static size_t _out_specifier(const out_sink_type* out, char* buffer, size_t idx, size_t maxlen, char specifier, unsigned int flags, unsigned int width, unsigned int precision, unsigned int fraction, va_list* va)
+{
+  // fetch '*' width and precision
+  if (flags & FLAGS_WIDTH_ARG) {
+    const int w = va_arg(*va, int);
+    if (w < 0) {
+      flags |= FLAGS_LEFT;    // reverse padding
+      width = (unsigned int)-w;
+    }
+    else {
+      width = (unsigned int)w;
     }
+  }
+  if (flags & FLAGS_PRECISION_ARG) {
+    const int prec = (int)va_arg(*va, int);
+    precision = prec > 0 ? (unsigned int)prec : 0U;
+  }
 
-    // evaluate specifier
-    switch (*format) {
-      case 'd' :
-      case 'i' :
-      case 'u' :
-      case 'x' :
-      case 'X' :
-      case 'o' :
-      case 'b' : {
-        // set the base
-        unsigned int base;
-        if (*format == 'x' || *format == 'X') {
-          base = 16U;
-        }
-        else if (*format == 'o') {
-          base =  8U;
-        }
-        else if (*format == 'b') {
-          base =  2U;
-        }
-        else {
-          base = 10U;
-          flags &= ~FLAGS_HASH;   // no hash for dec format
-        }
-        // uppercase
-        if (*format == 'X') {
-          flags |= FLAGS_UPPERCASE;
-        }
+  switch (specifier) {
+    case 'd' :
+    case 'i' :
+    case 'u' :
+    case 'x' :
+    case 'X' :
+    case 'o' :
+    case 'b' : {
+      // set the base
+      unsigned int base;
+      if (specifier == 'x' || specifier == 'X') {
+        base = 16U;
+      }
+      else if (specifier == 'o') {
+        base =  8U;
+      }
+      else if (specifier == 'b') {
+        base =  2U;
+      }
+      else {
+        base = 10U;
+        flags &= ~FLAGS_HASH;   // no hash for dec format
+      }
+      // uppercase
+      if (specifier == 'X') {
+        flags |= FLAGS_UPPERCASE;
+      }
 
-        // no plus or space flag for u, x, X, o, b
-        if ((*format != 'i') && (*format != 'd')) {
-          flags &= ~(FLAGS_PLUS | FLAGS_SPACE);
-        }
+      // no plus or space flag for u, x, X, o, b
+      if ((specifier != 'i') && (specifier != 'd')) {
+        flags &= ~(FLAGS_PLUS | FLAGS_SPACE);
+      }
 
-        // ignore '0' flag when precision is given
-        if (flags & FLAGS_PRECISION) {
-          flags &= ~FLAGS_ZEROPAD;
-        }
+      // ignore '0' flag when precision is given
+      if (flags & FLAGS_PRECISION) {
+        flags &= ~FLAGS_ZEROPAD;
+      }
 
-        // convert the integer
-        if ((*format == 'i') || (*format == 'd')) {
-          // signed
-          if (flags & FLAGS_LONG_LONG) {
+      // convert the integer
+      if ((specifier == 'i') || (specifier == 'd')) {
+        // signed
+        if (flags & FLAGS_LONG_LONG) {
 #if defined(PRINTF_SUPPORT_LONG_LONG)
-            const long long value = va_arg(va, long long);
-            idx = _ntoa_long_long(out, buffer, idx, maxlen, (unsigned long long)(value > 0 ? value : 0 - value), value < 0, base, precision, width, flags);
+          const long long value = va_arg(*va, long long);
+          idx = _ntoa_long_long(out, buffer, idx, maxlen, (unsigned long long)(value > 0 ? value : 0 - value), value < 0, base, precision, width, flags);
 #endif
-          }
-          else if (flags & FLAGS_LONG) {
-            const long value = va_arg(va, long);
-            idx = _ntoa_long(out, buffer, idx, maxlen, (unsigned long)(value > 0 ? value : 0 - value), value < 0, base, precision, width, flags);
-          }
-          else {
-            const int value = (flags & FLAGS_CHAR) ? (char)va_arg(va, int) : (flags & FLAGS_SHORT) ? (short int)va_arg(va, int) : va_arg(va, int);
-            idx = _ntoa_long(out, buffer, idx, maxlen, (unsigned int)(value > 0 ? value : 0 - value), value < 0, base, precision, width, flags);
-          }
+        }
+        else if (flags & FLAGS_LONG) {
+          const long value = va_arg(*va, long);
+          idx = _ntoa_long(out, buffer, idx, maxlen, (unsigned long)(value > 0 ? value : 0 - value), value < 0, base, precision, width, flags);
         }
         else {
-          // unsigned
-          if (flags & FLAGS_LONG_LONG) {
+          const int value = (flags & FLAGS_CHAR) ? (char)va_arg(*va, int) : (flags & FLAGS_SHORT) ? (short int)va_arg(*va, int) : va_arg(*va, int);
+          idx = _ntoa_long(out, buffer, idx, maxlen, (unsigned int)(value > 0 ? value : 0 - value), value < 0, base, precision, width, flags);
+        }
+      }
+      else {
+        // unsigned
+        if (flags & FLAGS_LONG_LONG) {
 #if defined(PRINTF_SUPPORT_LONG_LONG)
-            idx = _ntoa_long_long(out, buffer, idx, maxlen, va_arg(va, unsigned long long), false, base, precision, width, flags);
+          idx = _ntoa_long_long(out, buffer, idx, maxlen, va_arg(*va, unsigned long long), false, base, precision, width, flags);
 #endif
-          }
-          else if (flags & FLAGS_LONG) {
-            idx = _ntoa_long(out, buffer, idx, maxlen, va_arg(va, unsigned long), false, base, precision, width, flags);
-          }
-          else {
-            const unsigned int value = (flags & FLAGS_CHAR) ? (unsigned char)va_arg(va, unsigned int) : (flags & FLAGS_SHORT) ? (unsigned short int)va_arg(va, unsigned int) : va_arg(va, unsigned int);
-            idx = _ntoa_long(out, buffer, idx, maxlen, value, false, base, precision, width, flags);
-          }
         }
-        format++;
-        break;
+        else if (flags & FLAGS_LONG) {
+          idx = _ntoa_long(out, buffer, idx, maxlen, va_arg(*va, unsigned long), false, base, precision, width, flags);
+        }
+        else {
+          const unsigned int value = (flags & FLAGS_CHAR) ? (unsigned char)va_arg(*va, unsigned int) : (flags & FLAGS_SHORT) ? (unsigned short int)va_arg(*va, unsigned int) : va_arg(*va, unsigned int);
+          idx = _ntoa_long(out, buffer, idx, maxlen, value, false, base, precision, width, flags);
+        }
       }
+      break;
+    }
 #if defined(PRINTF_SUPPORT_FLOAT)
-      case 'f' :
-      case 'F' :
-        if (*format == 'F') flags |= FLAGS_UPPERCASE;
-        idx = _ftoa(out, buffer, idx, maxlen, va_arg(va, double), precision, width, flags);
-        format++;
-        break;
+    case 'f' :
+    case 'F' :
+      if (specifier == 'F') flags |= FLAGS_UPPERCASE;
+      idx = _ftoa(out, buffer, idx, maxlen, va_arg(*va, double), precision, width, flags);
+      break;
 #if defined(PRINTF_SUPPORT_EXPONENTIAL)
-      case 'e':
-      case 'E':
-      case 'g':
-      case 'G':
-        if ((*format == 'g')||(*format == 'G')) flags |= FLAGS_ADAPT_EXP;
-        if ((*format == 'E')||(*format == 'G')) flags |= FLAGS_UPPERCASE;
-        idx = _etoa(out, buffer, idx, maxlen, va_arg(va, double), precision, width, flags);
-        format++;
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+      if ((specifier == 'g')||(specifier == 'G')) flags |= FLAGS_ADAPT_EXP;
+      if ((specifier == 'E')||(specifier == 'G')) flags |= FLAGS_UPPERCASE;
+#if defined(PRINTF_SUPPORT_SHORTEST_FLOAT)
+      // %#g keeps the trailing zeros of the default precision
+      if ((flags & FLAGS_ADAPT_EXP) && !(flags & (FLAGS_PRECISION | FLAGS_HASH))) {
+        idx = _gtoa_shortest(out, buffer, idx, maxlen, va_arg(*va, double), width, flags);
         break;
+      }
+#endif
+      idx = _etoa(out, buffer, idx, maxlen, va_arg(*va, double), precision, width, flags);
+      break;
 #endif  // PRINTF_SUPPORT_EXPONENTIAL
 #endif  // PRINTF_SUPPORT_FLOAT
-      case 'c' : {
-        unsigned int l = 1U;
-        // pre padding
-        if (!(flags & FLAGS_LEFT)) {
-          while (l++ < width) {
-            out(' ', buffer, idx++, maxlen);
-          }
-        }
-        // char output
-        out((char)va_arg(va, int), buffer, idx++, maxlen);
-        // post padding
-        if (flags & FLAGS_LEFT) {
-          while (l++ < width) {
-            out(' ', buffer, idx++, maxlen);
-          }
-        }
-        format++;
-        break;
+#if defined(PRINTF_SUPPORT_FIXED_POINT)
+    case 'k' :
+    case 'q' : {
+      // signed, value / 10^precision or Q format value / 2^fraction
+      fixed_type value = 0U;
+      bool negative = false;
+      if (flags & FLAGS_LONG_LONG) {
+#if defined(PRINTF_SUPPORT_LONG_LONG)
+        const long long v = va_arg(*va, long long);
+        value    = (v < 0) ? 0U - (fixed_type)v : (fixed_type)v;
+        negative = v < 0;
+#endif
+      }
+      else if (flags & FLAGS_LONG) {
+        const long v = va_arg(*va, long);
+        value    = (v < 0) ? 0UL - (unsigned long)v : (unsigned long)v;
+        negative = v < 0;
+      }
+      else {
+        const int v = (flags & FLAGS_CHAR) ? (signed char)va_arg(*va, int) : (flags & FLAGS_SHORT) ? (short int)va_arg(*va, int) : va_arg(*va, int);
+        value    = (v < 0) ? 0U - (unsigned int)v : (unsigned int)v;
+        negative = v < 0;
+      }
+      if (specifier == 'k') {
+        idx = _ktoa(out, buffer, idx, maxlen, value, negative, precision, width, flags);
+      }
+      else {
+        idx = _qtoa(out, buffer, idx, maxlen, value, negative, fraction, (flags & FLAGS_PRECISION) ? precision : PRINTF_DEFAULT_FLOAT_PRECISION, width, flags);
+      }
+      break;
+    }
+#endif  // PRINTF_SUPPORT_FIXED_POINT
+    case 'c' : {
+      const size_t pad = (width > 1U) ? width - 1U : 0U;
+      // pre padding
+      if (!(flags & FLAGS_LEFT)) {
+        idx = _out_fill(out, buffer, idx, maxlen, ' ', pad);
       }
+      // char output
+      out->fct((char)va_arg(*va, int), buffer, idx++, maxlen);
+      // post padding
+      if (flags & FLAGS_LEFT) {
+        idx = _out_fill(out, buffer, idx, maxlen, ' ', pad);
+      }
+      break;
+    }
 
-      case 's' : {
-        const char* p = va_arg(va, char*);
-        unsigned int l = _strnlen_s(p, precision ? precision : (size_t)-1);
-        // pre padding
-        if (flags & FLAGS_PRECISION) {
-          l = (l < precision ? l : precision);
-        }
-        if (!(flags & FLAGS_LEFT)) {
-          while (l++ < width) {
-            out(' ', buffer, idx++, maxlen);
-          }
-        }
-        // string output
-        while ((*p != 0) && (!(flags & FLAGS_PRECISION) || precision--)) {
-          out(*(p++), buffer, idx++, maxlen);
-        }
-        // post padding
-        if (flags & FLAGS_LEFT) {
-          while (l++ < width) {
-            out(' ', buffer, idx++, maxlen);
-          }
-        }
-        format++;
-        break;
+    case 's' : {
+      const char* p = va_arg(*va, char*);
+      unsigned int l = _strnlen_s(p, precision ? precision : (size_t)-1);
+      if (flags & FLAGS_PRECISION) {
+        l = (l < precision ? l : precision);
+      }
+      const size_t pad = (l < width) ? width - l : 0U;
+      // pre padding
+      if (!(flags & FLAGS_LEFT)) {
+        idx = _out_fill(out, buffer, idx, maxlen, ' ', pad);
+      }
+      // string output
+      idx = _out_span(out, buffer, idx, maxlen, p, l);
+      // post padding
+      if (flags & FLAGS_LEFT) {
+        idx = _out_fill(out, buffer, idx, maxlen, ' ', pad);
       }
+      break;
+    }
 
-      case 'p' : {
-        width = sizeof(void*) * 2U;
-        flags |= FLAGS_ZEROPAD | FLAGS_UPPERCASE;
+    case 'p' : {
+      width = sizeof(void*) * 2U;
+      flags |= FLAGS_ZEROPAD | FLAGS_UPPERCASE;
 #if defined(PRINTF_SUPPORT_LONG_LONG)
-        const bool is_ll = sizeof(uintptr_t) == sizeof(long long);
-        if (is_ll) {
-          idx = _ntoa_long_long(out, buffer, idx, maxlen, (uintptr_t)va_arg(va, void*), false, 16U, precision, width, flags);
-        }
-        else {
+      const bool is_ll = sizeof(uintptr_t) == sizeof(long long);
+      if (is_ll) {
+        idx = _ntoa_long_long(out, buffer, idx, maxlen, (uintptr_t)va_arg(*va, void*), false, 16U, precision, width, flags);
+      }
+      else {
 #endif
-          idx = _ntoa_long(out, buffer, idx, maxlen, (unsigned long)((uintptr_t)va_arg(va, void*)), false, 16U, precision, width, flags);
+        idx = _ntoa_long(out, buffer, idx, maxlen, (unsigned long)((uintptr_t)va_arg(*va, void*)), false, 16U, precision, width, flags);
 #if defined(PRINTF_SUPPORT_LONG_LONG)
-        }
+      }
 #endif
-        format++;
-        break;
+      break;
+    }
+
+    case '%' :
+      out->fct('%', buffer, idx++, maxlen);
+      break;
+
+    default :
+      out->fct(specifier, buffer, idx++, maxlen);
+      break;
+  }
+
+  return idx;
+}
+
+
+#if (PRINTF_FORMAT_CACHE_SIZE > 0U)
+// one step of a format program: the literal run in front of a conversion, then the conversion
+// the last step of a program has no conversion, specifier is 0
+typedef struct {
+  uint16_t literal_offset;
+  uint16_t literal_len;
+  uint16_t flags;
+  uint16_t width;
+  uint16_t precision;
+  char     specifier;
+  uint8_t  fraction;
+} format_step_type;
+
+// format program, the parsed form of a format string
+typedef struct {
+  const char*      format;    // cache key, NULL if the slot is free
+  size_t           count;
+  format_step_type step[PRINTF_FORMAT_PROGRAM_MAX_STEPS];
+} format_program_type;
+
+// placeholder key of a slot that is being filled
+#define FORMAT_CACHE_BUSY  ((const char*)(uintptr_t)1U)
+
+// the slots are claimed on first use and never evicted, a published program
+// is immutable, so concurrent callers can run it without any locking
+static format_program_type _format_cache[PRINTF_FORMAT_CACHE_SIZE];
+static unsigned long _format_cache_hits;
+static unsigned long _format_cache_misses;
+
+
+// internal format compiler
+// \return false if the format does not fit a program, it is then interpreted on every call
+static bool _format_compile(format_program_type* program, const char* format)
+{
+  const char* const start = format;
+  size_t count = 0U;
+
+  for (;;) {
+    if (count >= PRINTF_FORMAT_PROGRAM_MAX_STEPS) {
+      return false;
+    }
+    format_step_type* step = &program->step[count++];
+    const char* run = format;
+    while (*format && (*format != '%')) {
+      format++;
+    }
+    if ((size_t)(format - start) > 0xFFFFU) {
+      return false;
+    }
+    step->literal_offset = (uint16_t)(run - start);
+    step->literal_len    = (uint16_t)(format - run);
+    step->specifier      = 0;
+    if (!*format) {
+      break;
+    }
+
+    char specifier;
+    unsigned int flags, width, precision, fraction;
+    format = _parse_specifier(format + 1, &specifier, &flags, &width, &precision, &fraction);
+    if (!format || (width > 0xFFFFU) || (precision > 0xFFFFU) || (fraction > 0xFFU)) {
+      return false;
+    }
+    step->flags     = (uint16_t)flags;
+    step->width     = (uint16_t)width;
+    step->precision = (uint16_t)precision;
+    step->specifier = specifier;
+    step->fraction  = (uint8_t)fraction;
+  }
+
+  program->count = count;
+  return true;
+}
+
+
+// internal format cache lookup, compiles the format on a miss if a slot is free
+// \return The program of the format, NULL if it is interpreted
+static const format_program_type* _format_program(const char* format)
+{
+  // one unsigned comparison for the range, also without a warning when MIN is 0
+  if (((uintptr_t)format - PRINTF_FORMAT_CACHE_ADDRESS_MIN) > (PRINTF_FORMAT_CACHE_ADDRESS_MAX - PRINTF_FORMAT_CACHE_ADDRESS_MIN)) {
+    return NULL;
+  }
+
+  size_t slot = (((uintptr_t)format >> 2U) * 2654435761UL) % PRINTF_FORMAT_CACHE_SIZE;
+  for (size_t probe = 0U; probe < PRINTF_FORMAT_CACHE_PROBES; probe++) {
+    format_program_type* program = &_format_cache[slot];
+    const char* key = __atomic_load_n(&program->format, __ATOMIC_ACQUIRE);
+    if (!key) {
+      if (__atomic_compare_exchange_n(&program->format, &key, FORMAT_CACHE_BUSY, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+        __atomic_fetch_add(&_format_cache_misses, 1U, __ATOMIC_RELAXED);
+        if (!_format_compile(program, format)) {
+          // remember the format with an empty program, so it is not compiled again
+          program->count = 0U;
+        }
+        // publish the program, readers see it complete
+        __atomic_store_n(&program->format, format, __ATOMIC_RELEASE);
+        return program->count ? program : NULL;
+      }
+      // claimed by another caller in the meantime, key holds its value now
+    }
+    if (key == format) {
+      if (!program->count) {
+        // known not to fit a program
+        __atomic_fetch_add(&_format_cache_misses, 1U, __ATOMIC_RELAXED);
+        return NULL;
       }
+      __atomic_fetch_add(&_format_cache_hits, 1U, __ATOMIC_RELAXED);
+      return program;
+    }
+    if (key == FORMAT_CACHE_BUSY) {
+      // another caller is compiling into this slot, possibly this same format,
+      // probing on could claim a second slot for it, so interpret this call
+      __atomic_fetch_add(&_format_cache_misses, 1U, __ATOMIC_RELAXED);
+      return NULL;
+    }
+    slot = (slot + 1U) % PRINTF_FORMAT_CACHE_SIZE;
+  }
+
+  // probed slots all taken
+  __atomic_fetch_add(&_format_cache_misses, 1U, __ATOMIC_RELAXED);
+  return NULL;
+}
+#endif  // PRINTF_FORMAT_CACHE_SIZE
 
-      case '%' :
-        out('%', buffer, idx++, maxlen);
-        format++;
-        break;
 
-      default :
-        out(*format, buffer, idx++, maxlen);
+// internal vsnprintf
+static int _vsnprintf(const out_sink_type* out, char* buffer, const size_t maxlen, const char* format, va_list va)
+{
+  char specifier;
+  unsigned int flags, width, precision, fraction;
+  size_t idx = 0U;
+  va_list args;
+
+  if (!buffer) {
+    // use null output function
+    out = &_sink_null;
+  }
+
+  // the conversions take the arguments through a pointer, which needs a local copy
+  va_copy(args, va);
+
+#if (PRINTF_FORMAT_CACHE_SIZE > 0U)
+  const format_program_type* program = _format_program(format);
+  if (program) {
+    // run the cached program, no parsing
+    for (size_t i = 0U; i < program->count; i++) {
+      const format_step_type* step = &program->step[i];
+      idx = _out_span(out, buffer, idx, maxlen, format + step->literal_offset, step->literal_len);
+      if (step->specifier) {
+        idx = _out_specifier(out, buffer, idx, maxlen, step->specifier, step->flags, step->width, step->precision, step->fraction, &args);
+      }
+    }
+    format = "";
+  }
+#endif
+
+  while (*format)
+  {
+    // format specifier?  %[flags][width][.precision][length]
+    if (*format != '%') {
+      // no, output the literal run up to the next specifier as one span
+      const char* run = format;
+      while (*format && (*format != '%')) {
         format++;
-        break;
+      }
+      idx = _out_span(out, buffer, idx, maxlen, run, (size_t)(format - run));
+      continue;
     }
+
+    // yes, evaluate it
+    format = _parse_specifier(format + 1, &specifier, &flags, &width, &precision, &fraction);
+    if (!format) {
+      // format ends inside the specifier
+      break;
+    }
+    idx = _out_specifier(out, buffer, idx, maxlen, specifier, flags, width, precision, fraction, &args);
   }
 
+  va_end(args);
+
   // termination
-  out((char)0, buffer, idx < maxlen ? idx : maxlen - 1U, maxlen);
+  out->fct((char)0, buffer, idx < maxlen ? idx : maxlen - 1U, maxlen);
 
   // return written chars without terminating \0
   return (int)idx;
@@ -864,7 +2210,7 @@ int printf_(const char* format, ...)
   va_list va;
   va_start(va, format);
   char buffer[1];
-  const int ret = _vsnprintf(_out_char, buffer, (size_t)-1, format, va);
+  const int ret = _vsnprintf(&_sink_char, buffer, (size_t)-1, format, va);
   va_end(va);
   return ret;
 }
@@ -874,7 +2220,7 @@ int sprintf_(char* buffer, const char* format, ...)
 {
   va_list va;
   va_start(va, format);
-  const int ret = _vsnprintf(_out_buffer, buffer, (size_t)-1, format, va);
+  const int ret = _vsnprintf(&_sink_buffer, buffer, (size_t)-1, format, va);
   va_end(va);
   return ret;
 }
@@ -884,7 +2230,7 @@ int snprintf_(char* buffer, size_t count, const char* format, ...)
 {
   va_list va;
   va_start(va, format);
-  const int ret = _vsnprintf(_out_buffer, buffer, count, format, va);
+  const int ret = _vsnprintf(&_sink_buffer, buffer, count, format, va);
   va_end(va);
   return ret;
 }
@@ -893,13 +2239,13 @@ int snprintf_(char* buffer, size_t count, const char* format, ...)
 int vprintf_(const char* format, va_list va)
 {
   char buffer[1];
-  return _vsnprintf(_out_char, buffer, (size_t)-1, format, va);
+  return _vsnprintf(&_sink_char, buffer, (size_t)-1, format, va);
 }
 
 
 int vsnprintf_(char* buffer, size_t count, const char* format, va_list va)
 {
-  return _vsnprintf(_out_buffer, buffer, count, format, va);
+  return _vsnprintf(&_sink_buffer, buffer, count, format, va);
 }
 
 
@@ -908,7 +2254,19 @@ int fctprintf(void (*out)(char character, void* arg), void* arg, const char* for
   va_list va;
   va_start(va, format);
   const out_fct_wrap_type out_fct_wrap = { out, arg };
-  const int ret = _vsnprintf(_out_fct, (char*)(uintptr_t)&out_fct_wrap, (size_t)-1, format, va);
+  const int ret = _vsnprintf(&_sink_fct, (char*)(uintptr_t)&out_fct_wrap, (size_t)-1, format, va);
   va_end(va);
   return ret;
 }
+
+
+void printf_format_cache_stats(unsigned long* hits, unsigned long* misses)
+{
+#if (PRINTF_FORMAT_CACHE_SIZE > 0U)
+  *hits   = __atomic_load_n(&_format_cache_hits, __ATOMIC_RELAXED);
+  *misses = __atomic_load_n(&_format_cache_misses, __ATOMIC_RELAXED);
+#else
+  *hits   = 0UL;
+  *misses = 0UL;
+#endif
+}
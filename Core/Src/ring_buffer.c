@@ -0,0 +1,235 @@
+/*
+ * ring_buffer.c
+ *
+ *  Created on: 2026. okt. 17.
+ *      Author: Balint
+ */
+#include "ring_buffer.h"
+#include "stm32f4xx_hal.h"
+
+#define RING_BUFFER_HEAD(desc_head, data_head)	(((uint32_t)(uint16_t)(desc_head) << 16) | (uint16_t)(data_head))
+
+/**
+  * @brief  Initializes a ring buffer
+  * @param  rb points to the ring buffer to be initialized
+  * @param  buffer points to the storage of the message bytes
+  * @param  buffer_size size of the storage in bytes (power of two, max 32768)
+  * @param  desc points to the descriptor array
+  * @param  desc_count number of descriptors (power of two, max 32768)
+  * @retval None
+  */
+void ring_buffer_init(ring_buffer_t *rb, uint8_t *buffer, uint32_t buffer_size, ring_buffer_desc_t *desc, uint32_t desc_count)
+{
+	assert_param(NULL != rb);
+	assert_param(NULL != buffer);
+	assert_param(NULL != desc);
+	assert_param((0 != buffer_size) && (buffer_size <= 32768) && (0 == (buffer_size & (buffer_size - 1))));
+	assert_param((0 != desc_count)  && (desc_count  <= 32768) && (0 == (desc_count  & (desc_count  - 1))));
+
+	rb->buffer      = buffer;
+	rb->buffer_size = buffer_size;
+	rb->desc        = desc;
+	rb->desc_count  = desc_count;
+	rb->head        = 0;
+	rb->data_tail   = 0;
+	rb->desc_tail   = 0;
+	rb->desc_read   = 0;
+
+	for (uint32_t i = 0; i < desc_count; i++) {
+		desc[i].pos       = 0;
+		desc[i].size      = 0;
+		desc[i].committed = 0;
+	}
+}
+
+/**
+  * @brief  Reserves a contiguous region in the ring buffer
+  * @param  rb points to the ring buffer
+  * @param  size number of bytes to be reserved
+  * @param  handle points where the handle of the reservation can be stored
+  * @retval pointer to the reserved region, NULL if there is not enough space
+  * @note	This function never blocks and is safe to be called from any task
+  * 		or interrupt. The reservation is lock-free (LDREX/STREX), the
+  * 		records are consumed in the order of their reservation.
+  * @note	A region never wraps around, if it does not fit before the end of
+  * 		the buffer the gap is skipped and the region starts at offset 0.
+  */
+uint8_t *ring_buffer_reserve(ring_buffer_t *rb, uint16_t size, uint16_t *handle)
+{
+	uint32_t head;
+	uint16_t desc_head;
+	uint16_t pos;
+	uint32_t offset;
+
+	assert_param((0 != size) && (size <= rb->buffer_size));
+
+	do {
+		head      = __LDREXW((volatile uint32_t *)&rb->head);
+		desc_head = (uint16_t)(head >> 16);
+		pos       = (uint16_t)head;
+		offset    = pos & (rb->buffer_size - 1U);
+
+		if (offset + size > rb->buffer_size) {
+			pos = (uint16_t)(pos + (rb->buffer_size - offset));
+		}
+
+		if (((uint16_t)(pos + size - rb->data_tail) > rb->buffer_size) ||
+			((uint16_t)(desc_head - rb->desc_tail) >= rb->desc_count)) {
+			__CLREX();
+			return NULL;
+		}
+
+	} while (0 != __STREXW(RING_BUFFER_HEAD(desc_head + 1U, pos + size), (volatile uint32_t *)&rb->head));
+
+	ring_buffer_desc_t *desc = &rb->desc[desc_head & (rb->desc_count - 1U)];
+	desc->pos  = pos;
+	desc->size = size;
+
+	*handle = desc_head;
+
+	return &rb->buffer[pos & (rb->buffer_size - 1U)];
+}
+
+/**
+  * @brief  Commits a reserved region, making it visible to the consumer
+  * @param  rb points to the ring buffer
+  * @param  handle of the reservation returned by ring_buffer_reserve
+  * @param  size number of bytes actually used (less or equal to the reserved size)
+  * @retval None
+  * @note	If no other reservation was made since this one, the unused part
+  * 		of the region is given back, so the next record is packed right
+  * 		after this one.
+  */
+void ring_buffer_commit(ring_buffer_t *rb, uint16_t handle, uint16_t size)
+{
+	ring_buffer_desc_t *desc = &rb->desc[handle & (rb->desc_count - 1U)];
+
+	assert_param(0 == desc->committed);
+	assert_param(size <= desc->size);
+
+	if (size < desc->size) {
+		const uint32_t reserved_head = RING_BUFFER_HEAD(handle + 1U, desc->pos + desc->size);
+
+		do {
+			if (reserved_head != __LDREXW((volatile uint32_t *)&rb->head)) {
+				__CLREX();
+				break;
+			}
+		} while (0 != __STREXW(RING_BUFFER_HEAD(handle + 1U, desc->pos + size), (volatile uint32_t *)&rb->head));
+
+		desc->size = size;
+	}
+
+	__DMB();
+	desc->committed = 1;
+}
+
+/**
+  * @brief  Reads the oldest committed records that are contiguous in memory
+  * @param  rb points to the ring buffer
+  * @param  max_size no more records are coalesced once their total size would
+  * 		exceed it, the first record is returned regardless
+  * @param  size points where the total size of the records can be stored
+  * @param  count points where the number of the records can be stored
+  * @retval pointer to the first record, NULL if the oldest record is not committed yet
+  * @note	This function should only be called by the consumer. The records
+  * 		stay valid until ring_buffer_release is called.
+  * @note	Records are coalesced as long as they are committed and each one
+  * 		starts where the previous one ended, so they can be handed over
+  * 		to a single DMA transfer.
+  */
+uint8_t *ring_buffer_read(ring_buffer_t *rb, uint16_t max_size, uint16_t *size, uint16_t *count)
+{
+	const uint16_t desc_head = (uint16_t)(rb->head >> 16);
+	ring_buffer_desc_t *desc;
+	uint16_t start = 0;
+	uint16_t end   = 0;
+	uint16_t n = 0;
+
+	while (rb->desc_read != desc_head) {
+		desc = &rb->desc[rb->desc_read & (rb->desc_count - 1U)];
+
+		if (0 == desc->committed) {
+			break;
+		}
+
+		__DMB();
+
+		if (0 == n) {
+			start = desc->pos;
+		} else if ((desc->pos != end) || (0 == (end & (rb->buffer_size - 1U)))) {
+			/* Gap (skipped end of buffer or a reservation that could not be shrunk) */
+			break;
+		} else if (((uint32_t)(uint16_t)(end - start) + desc->size) > max_size) {
+			break;
+		}
+
+		end           = (uint16_t)(desc->pos + desc->size);
+		rb->desc_read = (uint16_t)(rb->desc_read + 1U);
+		n++;
+	}
+
+	if (0 == n) {
+		return NULL;
+	}
+
+	*size  = (uint16_t)(end - start);
+	*count = n;
+
+	return &rb->buffer[start & (rb->buffer_size - 1U)];
+}
+
+/**
+  * @brief  Releases the records that were read, up to a given descriptor
+  * @param  rb points to the ring buffer
+  * @param  desc_end descriptor position (rb->desc_read after a ring_buffer_read)
+  * 		up to which the records are released, exclusive
+  * @retval None
+  * @note	This function should only be called by the consumer
+  */
+void ring_buffer_release(ring_buffer_t *rb, uint16_t desc_end)
+{
+	assert_param((uint16_t)(rb->desc_read - desc_end) <= (uint16_t)(rb->desc_read - rb->desc_tail));
+
+	while (rb->desc_tail != desc_end) {
+		ring_buffer_desc_t *desc = &rb->desc[rb->desc_tail & (rb->desc_count - 1U)];
+		const uint16_t data_tail = (uint16_t)(desc->pos + desc->size);
+
+		desc->committed = 0;
+		__DMB();
+
+		rb->data_tail = data_tail;
+		rb->desc_tail = (uint16_t)(rb->desc_tail + 1U);
+	}
+}
+
+/**
+  * @brief  Skips the oldest committed records that were not read yet
+  * @param  rb points to the ring buffer
+  * @param  size number of bytes to be skipped, at least one record is skipped
+  * @retval number of records skipped
+  * @note	This function should only be called by the consumer or with the
+  * 		consumer locked out. The skipped records are never returned by
+  * 		ring_buffer_read, they are freed by the next ring_buffer_release
+  * 		past them.
+  */
+uint16_t ring_buffer_skip(ring_buffer_t *rb, uint16_t size)
+{
+	const uint16_t desc_head = (uint16_t)(rb->head >> 16);
+	uint32_t skipped = 0;
+	uint16_t n = 0;
+
+	while ((rb->desc_read != desc_head) && ((0 == n) || (skipped < size))) {
+		ring_buffer_desc_t *desc = &rb->desc[rb->desc_read & (rb->desc_count - 1U)];
+
+		if (0 == desc->committed) {
+			break;
+		}
+
+		skipped       = skipped + desc->size;
+		rb->desc_read = (uint16_t)(rb->desc_read + 1U);
+		n++;
+	}
+
+	return n;
+}
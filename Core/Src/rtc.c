@@ -153,6 +153,31 @@ void RTC_GetTime(uint8_t *hours, uint8_t *minutes, uint8_t *seconds)
 	*seconds = stime.Seconds;
 }
 
+/**
+  * @brief  Gets the current time from the RTC peripheral with sub-second resolution
+  * @param	seconds points where the seconds of the day can be stored
+  * @param  microseconds points where the microseconds of the second can be stored
+  * @retval None
+  * @note	The resolution is limited by the synchronous prescaler, with
+  * 		SynchPrediv 255 it is ~3.9 ms.
+  */
+void RTC_GetTimeOfDay(uint32_t *seconds, uint32_t *microseconds)
+{
+	RTC_TimeTypeDef stime = {0};
+	RTC_DateTypeDef sdate = {0};
+	HAL_StatusTypeDef ret;
+
+	ret = HAL_RTC_GetTime(&hrtc, &stime, RTC_FORMAT_BIN);
+	assert_param(HAL_OK == ret);
+
+	/* Unlocks the shadow registers */
+	ret = HAL_RTC_GetDate(&hrtc, &sdate, RTC_FORMAT_BIN);
+	assert_param(HAL_OK == ret);
+
+	*seconds      = ((uint32_t)stime.Hours * 3600U) + ((uint32_t)stime.Minutes * 60U) + stime.Seconds;
+	*microseconds = ((stime.SecondFraction - stime.SubSeconds) * 1000000U) / (stime.SecondFraction + 1U);
+}
+
 /**
   * @brief  Gets the current date from the RTC peripheral
   * @param	day points where the day value can be stored
@@ -6,12 +6,16 @@
  */
 #include "stm32f4xx_hal.h"
 
+#include "FreeRTOS.h"
+
 TIM_HandleTypeDef htim2;
-volatile uint32_t runtime_stats_timer;
+
+/* Counter value seen by the last read and the upper half of the 64-bit count */
+static uint32_t runtime_stats_timer_last;
+static uint32_t runtime_stats_timer_wraps;
 
 static void TIM2_Init(void);
 static void TIM2_Deinit(void);
-static void TIM2_PeriodElapsedCallback(TIM_HandleTypeDef *htim);
 
 /**
   * @brief  Configures a dedicated Timer peripheral for
@@ -25,11 +29,39 @@ void vConfigureTimerForRunTimeStats( void )
 	TIM2_Init();
 }
 
+/**
+  * @brief  Gets the Run-Time Stats counter value
+  * @param  None
+  * @retval microseconds since vConfigureTimerForRunTimeStats was called
+  * @note	This function is called by the FreeRTOS kernel. It must not be
+  * 		called from interrupts above configMAX_SYSCALL_INTERRUPT_PRIORITY.
+  * @note	The 32-bit TIM2 counter is extended to 64 bits without an
+  * 		interrupt: a counter value lower than the one seen by the previous
+  * 		read means the counter wrapped. This holds as long as it is read at
+  * 		least once per wrap period (~71.6 minutes), which every context
+  * 		switch and the 60 s timestamp rebase timer do.
+  */
+uint64_t ullGetRunTimeCounterValue( void )
+{
+	const UBaseType_t saved_interrupt_status = portSET_INTERRUPT_MASK_FROM_ISR();
+	const uint32_t counter = TIM2->CNT;
+
+	if (counter < runtime_stats_timer_last) {
+		runtime_stats_timer_wraps++;
+	}
+	runtime_stats_timer_last = counter;
+	const uint32_t wraps = runtime_stats_timer_wraps;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(saved_interrupt_status);
+
+	return ((uint64_t)wraps << 32) | counter;
+}
+
 /**
   * @brief	TIM2 peripheral initialization
   * @param  None
   * @retval None
-  * @note   The TIM2 interrupt priority level is set to 11
+  * @note	TIM2 is a 32-bit timer, it is started free-running at 1 MHz
+  * 		without interrupts.
   */
 static void TIM2_Init(void)
 {
@@ -38,13 +70,8 @@ static void TIM2_Init(void)
 	uint32_t              uwPrescalerValue = 0;
 	uint32_t              pFLatency;
 
-	runtime_stats_timer = 0;
-
-	/*Configure the TIM2 IRQ priority */
-	HAL_NVIC_SetPriority(TIM2_IRQn, 11, 0);
-
-	/* Enable the TIM2 global Interrupt */
-	HAL_NVIC_EnableIRQ(TIM2_IRQn);
+	runtime_stats_timer_last  = 0;
+	runtime_stats_timer_wraps = 0;
 
 	/* Enable TIM2 clock */
 	__HAL_RCC_TIM2_CLK_ENABLE();
@@ -62,13 +89,13 @@ static void TIM2_Init(void)
 
 	/* Initialize TIMx peripheral as follow:
 	 *
-	+ Period = [(TIM2CLK/10000) - 1]. to have a (1/10000) s time base.
+	+ Period = 0xFFFFFFFF to use the full 32-bit range.
 
 	+ Prescaler = (uwTimclock/1000000 - 1) to have a 1MHz counter clock.
 	+ ClockDivision = 0
 	+ Counter direction = Up
 	*/
-	htim2.Init.Period        = (1000000U / 10000U) - 1U;
+	htim2.Init.Period        = 0xFFFFFFFFU;
 	htim2.Init.Prescaler     = uwPrescalerValue;
 	htim2.Init.ClockDivision = 0;
 	htim2.Init.CounterMode   = TIM_COUNTERMODE_UP;
@@ -77,11 +104,8 @@ static void TIM2_Init(void)
 	ret = HAL_TIM_Base_Init(&htim2);
 	assert_param(HAL_OK == ret);
 
-	ret = HAL_TIM_RegisterCallback(&htim2, HAL_TIM_PERIOD_ELAPSED_CB_ID, TIM2_PeriodElapsedCallback);
-	assert_param(HAL_OK == ret);
-
-	/* Start the TIM time Base generation in interrupt mode */
-	ret = HAL_TIM_Base_Start_IT(&htim2);
+	/* Start the TIM time Base generation */
+	ret = HAL_TIM_Base_Start(&htim2);
 	assert_param(HAL_OK == ret);
 }
 
@@ -95,14 +119,8 @@ static void TIM2_Deinit(void)
 {
 	HAL_StatusTypeDef ret;
 
-	/* Stop the TIM time Base generation in interrupt mode */
-	ret = HAL_TIM_Base_Stop_IT(&htim2);
-	assert_param(HAL_OK == ret);
-
-	/* Disable the TIM2 global Interrupt */
-	HAL_NVIC_DisableIRQ(TIM2_IRQn);
-
-	ret = HAL_TIM_UnRegisterCallback(&htim2, HAL_TIM_PERIOD_ELAPSED_CB_ID);
+	/* Stop the TIM time Base generation */
+	ret = HAL_TIM_Base_Stop(&htim2);
 	assert_param(HAL_OK == ret);
 
 	ret = HAL_TIM_Base_DeInit(&htim2);
@@ -115,21 +133,6 @@ static void TIM2_Deinit(void)
 	__HAL_RCC_TIM2_RELEASE_RESET();
 }
 
-/**
-  * @brief	TIM2 Period elapsed callback
-  * @param  None
-  * @retval None
-  * @note	This function is called from the HAL library
-  * @note 	This function is called when the timer
-  * 		reaches its predefined period (10 kHz). By generating
-  * 		interrupt in every 0.1 ms the run time stats can be more
-  * 		accurately calculated.
-  */
-static void TIM2_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
-{
-	runtime_stats_timer++;
-}
-
 
 
 
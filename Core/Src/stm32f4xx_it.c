@@ -10,12 +10,13 @@
 
 #include "stm32f4xx_it.h"
 #include "stm32f4xx_hal.h"
+#include "irq_stats.h"
 
 extern DMA_HandleTypeDef  hdma_usart2_tx;
+extern DMA_HandleTypeDef  hdma_usart2_rx;
 extern HCD_HandleTypeDef  hhcd_USB_OTG_FS;
 extern UART_HandleTypeDef huart2;
 extern TIM_HandleTypeDef  htim7;
-extern TIM_HandleTypeDef  htim2;
 
 
 /******************************************************************************/
@@ -91,12 +92,24 @@ void DebugMon_Handler(void)
 /* please refer to the startup file (startup_stm32f4xx.s).                    */
 /******************************************************************************/
 
+/**
+  * @brief This function handles DMA1 stream5 global interrupt.
+  */
+void DMA1_Stream5_IRQHandler(void)
+{
+    IRQ_STATS_ENTER();
+    HAL_DMA_IRQHandler(&hdma_usart2_rx);
+    IRQ_STATS_EXIT(IRQ_STATS_DMA1_STREAM5);
+}
+
 /**
   * @brief This function handles DMA1 stream6 global interrupt.
   */
 void DMA1_Stream6_IRQHandler(void)
 {
+    IRQ_STATS_ENTER();
     HAL_DMA_IRQHandler(&hdma_usart2_tx);
+    IRQ_STATS_EXIT(IRQ_STATS_DMA1_STREAM6);
 }
 
 /**
@@ -104,7 +117,9 @@ void DMA1_Stream6_IRQHandler(void)
   */
 void USART2_IRQHandler(void)
 {
+	IRQ_STATS_ENTER();
 	HAL_UART_IRQHandler(&huart2);
+	IRQ_STATS_EXIT(IRQ_STATS_USART2);
 }
 
 /**
@@ -112,15 +127,9 @@ void USART2_IRQHandler(void)
   */
 void TIM7_IRQHandler(void)
 {
+	IRQ_STATS_ENTER();
 	HAL_TIM_IRQHandler(&htim7);
-}
-
-/**
-  * @brief This function handles TIM2 global interrupt.
-  */
-void TIM2_IRQHandler(void)
-{
-	HAL_TIM_IRQHandler(&htim2);
+	IRQ_STATS_EXIT(IRQ_STATS_TIM7);
 }
 
 /**
@@ -128,7 +137,9 @@ void TIM2_IRQHandler(void)
   */
 void OTG_FS_IRQHandler(void)
 {
+	IRQ_STATS_ENTER();
 	HAL_HCD_IRQHandler(&hhcd_USB_OTG_FS);
+	IRQ_STATS_EXIT(IRQ_STATS_OTG_FS);
 }
 
 
@@ -0,0 +1,225 @@
+/*
+ * timestamp.c
+ *
+ *  Created on: 2026. okt. 17.
+ *      Author: Balint
+ */
+#include "timestamp.h"
+#include "stm32f4xx_hal.h"
+#include "rtc.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+
+/* The base is moved forward periodically, so that any timestamp within
++-35 minutes of it can be converted. */
+#define TIMESTAMP_REBASE_PERIOD						pdMS_TO_TICKS(60U * 1000U)
+
+/**
+  * @brief  Wall-clock time at a given counter value
+  */
+typedef struct {
+	uint32_t counter;
+	uint32_t seconds;
+	uint32_t microseconds;
+} timestamp_base_t;
+
+TIM_HandleTypeDef htim5;
+
+static timestamp_base_t   timestamp_base;
+static StaticTimer_t      timestamp_rebase_timer_storage;
+static TimerHandle_t      timestamp_rebase_timer_handle;
+
+static void TIM5_Init(void);
+static void TIM5_Deinit(void);
+static void timestamp_rebase(uint32_t counter);
+static void timestamp_rebase_timer_callback(TimerHandle_t timer);
+
+/**
+  * @brief  Initializes the timestamp service
+  * @param  None
+  * @retval None
+  * @note	The RTC peripheral must be initialized before calling this function,
+  * 		it is read once here and the time is extended with the counter after.
+  */
+void timestamp_init(void)
+{
+	TIM5_Init();
+	timestamp_sync();
+
+	timestamp_rebase_timer_handle = xTimerCreateStatic(
+										"Timestamp",
+										TIMESTAMP_REBASE_PERIOD,
+										pdTRUE,
+										NULL,
+										timestamp_rebase_timer_callback,
+										&timestamp_rebase_timer_storage);
+	assert_param(NULL != timestamp_rebase_timer_handle);
+
+	BaseType_t ret = xTimerStart(timestamp_rebase_timer_handle, 0);
+	assert_param(pdPASS == ret);
+}
+
+/**
+  * @brief  Deinitializes the timestamp service
+  * @param  None
+  * @retval None
+  */
+void timestamp_deinit(void)
+{
+	BaseType_t ret = xTimerDelete(timestamp_rebase_timer_handle, portMAX_DELAY);
+	assert_param(pdPASS == ret);
+
+	TIM5_Deinit();
+}
+
+/**
+  * @brief  Synchronizes the timestamp service to the RTC
+  * @param  None
+  * @retval None
+  * @note	This function should be called after the RTC time was set. The RTC
+  * 		is not read periodically, since it runs from the LSI, which is less
+  * 		accurate than the HSE the counter runs from.
+  */
+void timestamp_sync(void)
+{
+	uint32_t seconds;
+	uint32_t microseconds;
+
+	RTC_GetTimeOfDay(&seconds, &microseconds);
+	const uint32_t counter = timestamp_get();
+
+	taskENTER_CRITICAL();
+	timestamp_base.counter      = counter;
+	timestamp_base.seconds      = seconds;
+	timestamp_base.microseconds = microseconds;
+	taskEXIT_CRITICAL();
+}
+
+/**
+  * @brief  Converts a timestamp to wall-clock time
+  * @param  timestamp value of the counter, see timestamp_get
+  * @param  seconds points where the seconds of the day can be stored
+  * @param  microseconds points where the microseconds of the second can be stored
+  * @retval None
+  * @note	The timestamp must be within +-35 minutes of the current time.
+  */
+void timestamp_to_time_of_day(uint32_t timestamp, uint32_t *seconds, uint32_t *microseconds)
+{
+	timestamp_base_t base;
+
+	taskENTER_CRITICAL();
+	base = timestamp_base;
+	taskEXIT_CRITICAL();
+
+	const int32_t offset = (int32_t)(timestamp - base.counter);
+	int32_t sec  = (int32_t)base.seconds + (offset / 1000000);
+	int32_t usec = (int32_t)base.microseconds + (offset % 1000000);
+
+	if (usec < 0) {
+		usec = usec + 1000000;
+		sec  = sec - 1;
+	} else if (usec >= 1000000) {
+		usec = usec - 1000000;
+		sec  = sec + 1;
+	}
+
+	sec = sec % 86400;
+	if (sec < 0) {
+		sec = sec + 86400;
+	}
+
+	*seconds      = (uint32_t)sec;
+	*microseconds = (uint32_t)usec;
+}
+
+/**
+  * @brief  Moves the base of the conversion to a counter value
+  * @param  counter new base counter value, must not be older than the current base
+  * @retval None
+  */
+static void timestamp_rebase(uint32_t counter)
+{
+	taskENTER_CRITICAL();
+	const uint32_t elapsed = counter - timestamp_base.counter;
+	const uint32_t microseconds = timestamp_base.microseconds + (elapsed % 1000000U);
+
+	timestamp_base.counter      = counter;
+	timestamp_base.seconds      = (timestamp_base.seconds + (elapsed / 1000000U) + (microseconds / 1000000U)) % 86400U;
+	timestamp_base.microseconds = microseconds % 1000000U;
+	taskEXIT_CRITICAL();
+}
+
+/**
+  * @brief  Rebase timer callback
+  * @param  timer handle of the timer
+  * @retval None
+  * @note	This function is called from the timer service task
+  */
+static void timestamp_rebase_timer_callback(TimerHandle_t timer)
+{
+	(void)timer;
+
+	timestamp_rebase(timestamp_get());
+
+	/* Keeps the 64-bit run-time stats counter extended when no context switch reads it */
+	(void)portGET_RUN_TIME_COUNTER_VALUE();
+}
+
+/**
+  * @brief	TIM5 peripheral initialization
+  * @param  None
+  * @retval None
+  * @note   TIM5 is a 32-bit timer, it is started free-running at 1 MHz
+  * 		without interrupts.
+  */
+static void TIM5_Init(void)
+{
+	uint32_t              uwTimclock = 0;
+	uint32_t              uwPrescalerValue = 0;
+
+	/* Enable TIM5 clock */
+	__HAL_RCC_TIM5_CLK_ENABLE();
+
+	/* Compute TIM5 clock */
+	uwTimclock = 2*HAL_RCC_GetPCLK1Freq();
+	/* Compute the prescaler value to have TIM5 counter clock equal to 1MHz */
+	uwPrescalerValue = (uint32_t) ((uwTimclock / 1000000U) - 1U);
+
+	htim5.Instance = TIMESTAMP_TIMER;
+
+	htim5.Init.Period        = 0xFFFFFFFFU;
+	htim5.Init.Prescaler     = uwPrescalerValue;
+	htim5.Init.ClockDivision = 0;
+	htim5.Init.CounterMode   = TIM_COUNTERMODE_UP;
+
+	HAL_StatusTypeDef ret;
+	ret = HAL_TIM_Base_Init(&htim5);
+	assert_param(HAL_OK == ret);
+
+	ret = HAL_TIM_Base_Start(&htim5);
+	assert_param(HAL_OK == ret);
+}
+
+/**
+  * @brief 	TIM5 peripheral de-initialization
+  * @param  None
+  * @retval None
+  */
+static void TIM5_Deinit(void)
+{
+	HAL_StatusTypeDef ret;
+
+	ret = HAL_TIM_Base_Stop(&htim5);
+	assert_param(HAL_OK == ret);
+
+	ret = HAL_TIM_Base_DeInit(&htim5);
+	assert_param(HAL_OK == ret);
+
+	/* Disable TIM5 clock */
+	__HAL_RCC_TIM5_CLK_DISABLE();
+
+	__HAL_RCC_TIM5_FORCE_RESET();
+	__HAL_RCC_TIM5_RELEASE_RESET();
+}
@@ -155,10 +155,11 @@ extern uint32_t SystemCoreClock;
 
 /**< Run-time statistics */
 extern void vConfigureTimerForRunTimeStats( void );
-extern volatile uint32_t runtime_stats_timer;
+extern uint64_t ullGetRunTimeCounterValue( void );
 
+#define configRUN_TIME_COUNTER_TYPE                   uint64_t
 #define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() 	  vConfigureTimerForRunTimeStats()
-#define portGET_RUN_TIME_COUNTER_VALUE()         	  ( runtime_stats_timer )
+#define portGET_RUN_TIME_COUNTER_VALUE()         	  ullGetRunTimeCounterValue()
 
 /**< SystemView related defines */
 #include "SEGGER_SYSVIEW_FreeRTOS.h"
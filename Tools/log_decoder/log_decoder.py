@@ -0,0 +1,335 @@
+#!/usr/bin/env python3
+#
+# log_decoder.py
+#
+#  Created on: 2026. okt. 17.
+#      Author: Balint
+#
+# Decodes the binary log frames sent by the firmware when LOG_BINARY is set
+# (see Core/Inc/log_record.h) back into the "[hh:mm:ss] TYPE: ..." text that
+# log_() prints. The format and type strings are looked up in the ELF file of
+# the firmware. Everything outside the frames (CLI output) is passed through.
+#
+# Usage:
+#   stty -F /dev/ttyACM0 115200 raw
+#   log_decoder.py Debug/FreeRTOS_printf_F407Discovery.elf /dev/ttyACM0
+#
+
+import argparse
+import math
+import re
+import struct
+import sys
+
+ADDRESS_BASE = 0x08000000
+SHF_ALLOC = 0x2
+SHT_NOBITS = 8
+
+SPEC_RE = re.compile(rb'%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d*))?(hh|h|ll|l|t|j|z)?(.)?', re.DOTALL)
+
+
+class Elf:
+    """Minimal ELF32 little endian reader, only the allocated sections are used"""
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.data = f.read()
+
+        if self.data[:4] != b'\x7fELF' or self.data[4] != 1 or self.data[5] != 1:
+            raise ValueError('%s is not a 32-bit little endian ELF file' % path)
+
+        e_shoff, = struct.unpack_from('<I', self.data, 0x20)
+        e_shentsize, e_shnum = struct.unpack_from('<HH', self.data, 0x2E)
+
+        self.sections = []
+        for i in range(e_shnum):
+            (_, sh_type, sh_flags, sh_addr, sh_offset, sh_size) = struct.unpack_from('<IIIIII', self.data, e_shoff + i * e_shentsize)
+            if (sh_flags & SHF_ALLOC) and sh_type != SHT_NOBITS and sh_size:
+                self.sections.append((sh_addr, sh_offset, sh_size))
+
+    def string(self, address):
+        for (addr, offset, size) in self.sections:
+            if addr <= address < addr + size:
+                start = offset + address - addr
+                end = self.data.index(b'\0', start, offset + size)
+                return self.data[start:end]
+        return None
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data) + 1:
+            raise ValueError('invalid COBS block')
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def varints(payload):
+    values = []
+    value = 0
+    shift = 0
+    for byte in payload:
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            values.append(value & 0xFFFFFFFF)
+            value = 0
+            shift = 0
+        elif shift > 28:
+            raise ValueError('invalid varint')
+    if shift:
+        raise ValueError('truncated varint')
+    return values
+
+
+def signed(value, bits):
+    value &= (1 << bits) - 1
+    return value - (1 << bits) if value & (1 << (bits - 1)) else value
+
+
+def to_float(number):
+    return struct.unpack('<f', struct.pack('<f', number))[0]
+
+
+def shortest_g(spec, conv, single, number):
+    """Mirrors _gtoa_shortest() in printf.c: %g without precision prints the
+    shortest digits that read back as the same double, or float for %hg"""
+    single = single and to_float(number) == number and abs(number) >= 2.0 ** -126
+    for p in range(1, 10 if single else 18):
+        text = '%.*e' % (p - 1, number)
+        if (to_float(float(text)) if single else float(text)) == number:
+            break
+    mantissa, exponent = text.lstrip('-').split('e')
+    digits = mantissa.replace('.', '')
+    x = int(exponent)
+
+    if x < -4 or x >= max(len(digits), 6):
+        body = digits[0] + ('.' + digits[1:] if len(digits) > 1 else '')
+        body += ('E' if conv == b'G' else 'e') + ('%+03d' % x)
+    elif x >= 0:
+        whole = digits[:x + 1].ljust(x + 1, '0')
+        body = whole + ('.' + digits[x + 1:] if len(digits) > x + 1 else '')
+    else:
+        body = '0.' + '0' * (-x - 1) + digits
+
+    return pad_number(spec, math.copysign(1.0, number) < 0, body)
+
+
+def fixed_point(spec, conv, value, fraction):
+    """Mirrors _ktoa() and _qtoa() in printf.c: %.Nk prints value / 10^N,
+    %.Nq<fraction> prints value / 2^fraction rounded to N decimals, more
+    fraction bits than the 64 of a long long print the specifier"""
+    precision = re.search(rb'\.(\d*)', spec)
+    magnitude = abs(value)
+    if conv == b'k':
+        decimals = int(precision.group(1) or 0) if precision else 0
+        scaled = magnitude
+    else:
+        decimals = int(precision.group(1) or 0) if precision else 6
+        if fraction > 64:
+            return b'%%q%d' % fraction
+        scaled, rest = divmod(magnitude * 10 ** decimals, 1 << fraction)
+        if fraction and (2 * rest > (1 << fraction) or (2 * rest == (1 << fraction) and scaled & 1)):
+            scaled += 1
+    digits = str(scaled).rjust(decimals + 1, '0')
+    body = digits[:-decimals] + '.' + digits[-decimals:] if decimals else digits
+    return pad_number(spec, value < 0, body)
+
+
+def pad_number(spec, negative, body):
+    """Sign and padding of a number as printf.c does it"""
+    flags, width = re.match(rb'%([-+ #0]*)(\d*)', spec).groups()
+    sign = '-' if negative else '+' if b'+' in flags else ' ' if b' ' in flags else ''
+    pad = max(int(width or 0) - len(sign) - len(body), 0)
+    if b'-' in flags:
+        text = sign + body + ' ' * pad
+    elif b'0' in flags:
+        text = sign + '0' * pad + body
+    else:
+        text = ' ' * pad + sign + body
+    return text.encode()
+
+
+class Decoder:
+
+    def __init__(self, elf, microseconds):
+        self.elf = elf
+        self.microseconds = microseconds
+        self.sync_seconds = None
+        self.sync_timestamp = 0
+        self.timestamp = 0
+
+    def format(self, fmt, words):
+        """Mirrors log_record_format(): same argument words per conversion"""
+        out = []
+        pos = 0
+        n = 0
+        while True:
+            start = fmt.find(b'%', pos)
+            if start < 0:
+                out.append(fmt[pos:])
+                break
+            out.append(fmt[pos:start])
+            m = SPEC_RE.match(fmt, start)
+            flags, width, precision, length, conv = m.groups()
+            if conv is None:
+                break
+            pos = m.end()
+            fraction = 16
+            if conv == b'q':
+                digits = re.compile(rb'\d*').match(fmt, pos)
+                fraction = int(digits.group() or 16)
+                pos = digits.end()
+
+            stars = [w for w in (width, precision) if w == b'*']
+            long_long = length == b'll'
+            if conv in b'diuxXobkq':
+                size = 2 if long_long else 1
+            elif conv in b'fFeEgG':
+                size = 2
+            elif conv in b'csp':
+                size = 1
+            else:
+                size = 0
+            if n + len(stars) + size > len(words):
+                break
+
+            if width == b'*':
+                value = signed(words[n], 32)
+                n += 1
+                if value < 0:
+                    flags += b'-'
+                width = str(abs(value)).encode()
+            if precision == b'*':
+                precision = str(max(signed(words[n], 32), 0)).encode()
+                n += 1
+
+            value_words = words[n:n + size]
+            n += size
+            value = value_words[0] | (value_words[1] << 32) if size == 2 else (value_words[0] if size else None)
+
+            spec = b'%' + flags + (width or b'') + ((b'.' + precision) if precision is not None else b'')
+            out.append(self.conversion(spec, conv, length, value, fraction))
+
+        return b''.join(out).decode('latin-1')
+
+    def conversion(self, spec, conv, length, value, fraction=16):
+        bits = {b'hh': 8, b'h': 16, b'll': 64}.get(length, 32)
+        c = conv.decode('latin-1')
+        if c in 'di':
+            return (spec + b'd') % signed(value, bits)
+        if c in 'uxXo':
+            value &= (1 << bits) - 1
+            return (spec + (b'd' if c == 'u' else conv)) % value
+        if c in 'kq':
+            return fixed_point(spec, conv, signed(value, bits), fraction)
+        if c == 'b':
+            return (spec + b's') % format(value & ((1 << bits) - 1), 'b').encode()
+        if c in 'fFeEgG':
+            number = struct.unpack('<d', struct.pack('<Q', value))[0]
+            if c in 'gG' and b'.' not in spec and b'#' not in spec and math.isfinite(number):
+                return shortest_g(spec, conv, length == b'h', number)
+            return (spec + conv) % number
+        if c == 'c':
+            return (spec + b'c') % (value & 0xFF)
+        if c == 's':
+            string = self.elf.string(value)
+            return (spec + b's') % (string if string is not None else b'<0x%08X>' % value)
+        if c == 'p':
+            return b'%08X' % value
+        if c == '%':
+            return b'%'
+        return conv
+
+    def frame(self, payload):
+        values = varints(payload)
+        if not values:
+            raise ValueError('empty frame')
+
+        if values[0] == 0:
+            self.sync_seconds, self.sync_timestamp = values[1], values[2]
+            self.timestamp = self.sync_timestamp
+            return None
+
+        fmt = self.elf.string(ADDRESS_BASE + values[0])
+        typ = self.elf.string(ADDRESS_BASE + values[1])
+        if fmt is None or typ is None:
+            raise ValueError('unknown string address')
+
+        delta = values[2]
+        self.timestamp = (self.timestamp + ((delta >> 1) ^ -(delta & 1))) & 0xFFFFFFFF
+
+        if self.sync_seconds is None:
+            stamp = '--:--:--.------' if self.microseconds else '--:--:--'
+        else:
+            seconds, microseconds = divmod(signed(self.timestamp - self.sync_timestamp, 32), 1000000)
+            seconds = (self.sync_seconds + seconds) % 86400
+            stamp = '%02d:%02d:%02d' % (seconds // 3600, (seconds // 60) % 60, seconds % 60)
+            if self.microseconds:
+                stamp += '.%06d' % microseconds
+
+        return '[%s] %s: %s' % (stamp, typ.decode('latin-1'), self.format(fmt, values[3:]))
+
+    def run(self, stream, output):
+        in_frame = False
+        frame = bytearray()
+        while True:
+            chunk = stream.read1(4096) if hasattr(stream, 'read1') else stream.read(4096)
+            if not chunk:
+                break
+            for byte in chunk:
+                if not in_frame:
+                    if byte == 0:
+                        in_frame = True
+                        frame.clear()
+                    else:
+                        output.write(chr(byte))
+                    continue
+
+                if byte != 0:
+                    frame.append(byte)
+                    continue
+
+                if not frame:
+                    # Two delimiters in a row, the second one starts a frame
+                    continue
+
+                try:
+                    text = self.frame(cobs_decode(bytes(frame)))
+                    if text is not None:
+                        output.write(text)
+                    in_frame = False
+                except (ValueError, IndexError):
+                    # Started in the middle of a frame, this delimiter opens the next one
+                    output.write(bytes(frame).decode('latin-1'))
+                frame.clear()
+            output.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decodes the binary log frames of the firmware')
+    parser.add_argument('elf', help='ELF file of the running firmware')
+    parser.add_argument('input', nargs='?', help='serial device or capture file (default: stdin)')
+    parser.add_argument('--microseconds', action='store_true', help='print [hh:mm:ss.uuuuuu] timestamps like LOG_TIMESTAMP_US')
+    args = parser.parse_args()
+
+    decoder = Decoder(Elf(args.elf), args.microseconds)
+
+    if args.input:
+        with open(args.input, 'rb', buffering=0) as stream:
+            decoder.run(stream, sys.stdout)
+    else:
+        decoder.run(sys.stdin.buffer, sys.stdout)
+
+
+if __name__ == '__main__':
+    try:
+        main()
+    except KeyboardInterrupt:
+        pass
@@ -0,0 +1,144 @@
+/*
+ * printf_bench.c
+ *
+ *  Host benchmark of Core/Src/printf.c on typical log formats.
+ *
+ *  Every case is formatted the way log_() does it: the timestamp prefix,
+ *  then the message, into a configCOMMAND_INT_MAX_OUTPUT_SIZE buffer. The
+ *  Makefile builds it once with the current printf.c and once with the
+ *  revision given in BEFORE, so the two can be compared.
+ *
+ *  Every case is timed RUNS times, the fastest run is reported.
+ *
+ *  Usage: printf_bench [iterations]
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "printf.h"
+
+/* The results are printed by the C library */
+#undef printf
+
+#define OUTPUT_SIZE									1024
+#define RUNS										5
+
+typedef enum {
+	BENCH_PREFIX = 0,
+	BENCH_TEXT,
+	BENCH_STRINGS,
+	BENCH_INTEGERS,
+	BENCH_HEX,
+	BENCH_PADDED,
+	BENCH_DROP_REPORT,
+	BENCH_FIXED,
+	BENCH_EXPONENTIAL,
+	BENCH_COUNT
+} bench_case_t;
+
+static const char * const bench_names[BENCH_COUNT] = {
+	"prefix", "text", "strings", "integers", "hex", "padded", "drop report", "fixed", "exponential"
+};
+
+static char output[OUTPUT_SIZE];
+
+/* Not used, the benchmark only formats into buffers */
+void _putchar(char character)
+{
+	(void)character;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static int log_prefix(unsigned long seconds, unsigned long microseconds)
+{
+	return snprintf(output, OUTPUT_SIZE, "[%02lu:%02lu:%02lu.%06lu] %s: ", seconds / 3600U, (seconds / 60U) % 60U, seconds % 60U, microseconds, "INFO");
+}
+
+static int bench_format(bench_case_t bench, unsigned long i)
+{
+	int len = log_prefix(i % 86400U, i % 1000000U);
+
+	switch (bench) {
+	case BENCH_PREFIX:
+		break;
+	case BENCH_TEXT:
+		len += snprintf(output + len, OUTPUT_SIZE - len, "USB host class activated, waiting for the device to enumerate\r\n");
+		break;
+	case BENCH_STRINGS:
+		len += snprintf(output + len, OUTPUT_SIZE - len, "task %s: state %s, queue %s\r\n", "CLI", "blocked", "uart_rx");
+		break;
+	case BENCH_INTEGERS:
+		len += snprintf(output + len, OUTPUT_SIZE - len, "sensor %u: %ld mV, %ld mA, %lu samples\r\n", (unsigned)(i & 7U), (long)(i % 3300U) - 100, -(long)(i % 1500U), i);
+		break;
+	case BENCH_HEX:
+		len += snprintf(output + len, OUTPUT_SIZE - len, "reg 0x%08lx = 0x%08lx (%#x)\r\n", 0x40004400UL + (i & 0xFCU), i * 2654435761UL, (unsigned)(i & 0xFFU));
+		break;
+	case BENCH_PADDED:
+		len += snprintf(output + len, OUTPUT_SIZE - len, "%-16s %8lu %8lu %5u.%u%%\r\n", "DMA1_Stream6", i, i / 3U, (unsigned)(i % 100U), (unsigned)(i % 10U));
+		break;
+	case BENCH_DROP_REPORT:
+		len += snprintf(output + len, OUTPUT_SIZE - len, "%lu messages dropped (%s %lu, %s %lu, %s %lu, %s %lu), %lu overwritten\r\n",
+				i, "debug", i / 2U, "info", i / 3U, "warning", i / 5U, "error", 0UL, i / 7U);
+		break;
+	case BENCH_FIXED:
+		len += snprintf(output + len, OUTPUT_SIZE - len, "sensor %u: %.2f C, %.3f V, %f A\r\n", (unsigned)(i & 7U),
+				(double)(i % 12000U) / 100.0 - 40.0, 3.3 * (double)(i % 4096U) / 4095.0, (double)(i % 1000U) * 0.0015);
+		break;
+	case BENCH_EXPONENTIAL:
+		len += snprintf(output + len, OUTPUT_SIZE - len, "fit %e, residual %.3e, gain %.4g\r\n",
+				(double)i * 1.25e-7, 1.0 / (double)(i + 1U), (double)(i % 5000U) * 0.37);
+		break;
+	default:
+		break;
+	}
+
+	return len;
+}
+
+int main(int argc, char *argv[])
+{
+	const unsigned long iterations = (argc > 1) ? strtoul(argv[1], NULL, 0) : 1000000UL;
+	uint64_t all_bytes = 0;
+	uint64_t all_ns = 0;
+
+	printf("%-12s %8s %12s %10s\n", "case", "bytes", "ns/message", "MB/s");
+
+	for (int bench = 0; bench < BENCH_COUNT; bench++) {
+		uint64_t bytes = 0;
+
+		/* Warm-up, also fills the format cache where there is one */
+		for (unsigned long i = 0; i < 1000U; i++) {
+			bench_format((bench_case_t)bench, i);
+		}
+
+		uint64_t elapsed = UINT64_MAX;
+		for (int run = 0; run < RUNS; run++) {
+			bytes = 0;
+			const uint64_t start = now_ns();
+			for (unsigned long i = 0; i < iterations; i++) {
+				bytes += (uint64_t)bench_format((bench_case_t)bench, i);
+			}
+			const uint64_t run_elapsed = now_ns() - start;
+			if (run_elapsed < elapsed) {
+				elapsed = run_elapsed;
+			}
+		}
+
+		printf("%-12s %8.1f %12.1f %10.1f\n", bench_names[bench], (double)bytes / (double)iterations,
+				(double)elapsed / (double)iterations, (double)bytes * 1e3 / (double)elapsed);
+		all_bytes += bytes;
+		all_ns    += elapsed;
+	}
+
+	printf("%-12s %8s %12s %10.1f\n", "all", "", "", (double)all_bytes * 1e3 / (double)all_ns);
+
+	return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * printf_test.c
+ *
+ *  Host test of the conversions of Core/Src/printf.c.
+ *
+ *  Every case is formatted into a buffer that is large enough, then into
+ *  truncating ones: the return value must be the full length and the
+ *  truncated output a terminated prefix of the full one.
+ *
+ *  Usage: printf_test
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "printf.h"
+
+/* The results are printed by the C library */
+#undef printf
+#undef snprintf
+
+#define OUTPUT_SIZE									256
+
+static unsigned int failures;
+
+/* Not used, the test only formats into buffers */
+void _putchar(char character)
+{
+	(void)character;
+}
+
+static void check(const char *file, int line, const char *format, const char *expected, const char *output, int len)
+{
+	if ((0 != strcmp(expected, output)) || ((int)strlen(expected) != len)) {
+		printf("FAIL %s:%d: \"%s\" printed \"%s\" (%d), expected \"%s\"\n", file, line, format, output, len, expected);
+		failures++;
+	}
+}
+
+/* Checks a conversion, then the same with every shorter buffer */
+#define CHECK(expected, format, ...)	do { \
+		char output_[OUTPUT_SIZE]; \
+		int len_ = snprintf_(output_, sizeof(output_), format, __VA_ARGS__); \
+		check(__FILE__, __LINE__, format, expected, output_, len_); \
+		for (size_t size_ = 1; size_ <= strlen(expected); size_++) { \
+			char truncated_[OUTPUT_SIZE]; \
+			memset(truncated_, '#', sizeof(truncated_)); \
+			len_ = snprintf_(truncated_, size_, format, __VA_ARGS__); \
+			if ((0 != strncmp(expected, truncated_, size_ - 1)) || ('\0' != truncated_[size_ - 1]) || ((int)strlen(expected) != len_)) { \
+				printf("FAIL %s:%d: \"%s\" truncated to %zu\n", __FILE__, __LINE__, format, size_); \
+				failures++; \
+				break; \
+			} \
+		} \
+	} while (0)
+
+static void test_scaled(void)
+{
+	CHECK("12.345", "%.3k", 12345);
+	CHECK("-0.005", "%.3k", -5);
+	CHECK("42", "%.0k", 42);
+	CHECK("   12.34|12.34   |-0012.34|+12.34", "%8.2k|%-8.2k|%08.2k|%+.2k", 1234, 1234, -1234, 1234);
+	CHECK("12345678.90123", "%.5llk", 1234567890123LL);
+	CHECK("-5", "%hhk", (signed char)-5);
+	CHECK("-32768", "%hk", (short)-32768);
+	CHECK("-21474836.48", "%.2k", INT32_MIN);
+
+	/* Precisions beyond the digit buffer */
+	CHECK("0.0000000000000000000000000000123", "%.31k", 123);
+	CHECK("0.00000000000000000000000000000000001", "%.35k", 1);
+	CHECK("-0.00000000000000000000000000000000001", "%.35k", -1);
+	CHECK("-000.00000000000000000000000000000000001", "%040.35k", -1);
+	CHECK("-0.00000000000000000000000000000000001  ", "%-40.35k", -1);
+	CHECK("-0.000000000000000000000000000000000009223372036854775808", "%.54llk", INT64_MIN);
+}
+
+static void test_q_format(void)
+{
+	CHECK("1.500", "%.3q16", 0x18000);
+	CHECK("3.000015", "%q", 65536 * 3 + 1);
+	CHECK("-1.5000", "%.4q8", -384);
+	CHECK("2.000", "%.3q16", 0x1FFFF);
+	CHECK("2", "%.0q16", 0x18000);
+	CHECK("0.50", "%.2q31", 0x40000000);
+	CHECK("-2.50", "%.2hhq1", (signed char)-5);
+	CHECK("-001.500|1.6       |", "%08.3q16|%-10.1q4|", -0x18000, 0x19);
+
+	/* All fraction bits of the argument */
+	CHECK("-1.00", "%.2llq63", INT64_MIN);
+	CHECK("-0.50", "%.2q32", INT32_MIN);
+	CHECK("-0.00", "%.2llq64", -1LL);
+	CHECK("0.50", "%.2llq64", INT64_MAX);
+	CHECK("-0.0000000000000000000542101086242752217003726400434970855712890625000000", "%.70llq64", -1LL);
+	CHECK("0.0000000002328306436538696289062500000000", "%.40q32", 1);
+	CHECK("-0.0000000013969838619232177734375000000000", "%.40q31", -3);
+
+	/* More fraction bits than any argument has */
+	CHECK("%q65 x", "%.2llq65 x", 1LL);
+}
+
+int main(void)
+{
+	test_scaled();
+	test_q_format();
+
+	printf("printf tests: %s\n", (0 == failures) ? "passed" : "FAILED");
+
+	return (0 == failures) ? 0 : 1;
+}
@@ -0,0 +1,575 @@
+/*
+ * ring_buffer_test.c
+ *
+ *  Host unit and throughput test of Core/Src/ring_buffer.c.
+ *
+ *  The unit tests check reservation, shrinking on commit, wrap-around,
+ *  full conditions, coalescing and skipping, then a randomized single
+ *  thread run checks the ring against a model. The throughput test runs
+ *  bursty producer threads against a consumer that simulates the UART DMA
+ *  (a fixed cost per transfer plus a cost per byte). It compares the ring
+ *  buffer with the 8 x 1 KB slot pool it replaced, where every message
+ *  takes a slot and is transmitted on its own. The consumer checks the
+ *  content and the per-producer order of every message.
+ *
+ *  Usage: ring_buffer_test [producers] [bursts] [burst length] [pause us]
+ *                          [ns per byte] [ns per transfer]
+ */
+#include "ring_buffer.h"
+#include "stm32f4xx_hal.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Same dimensions as the bulk lane in log_and_cli_io.c */
+#define TX_BUFFER_SIZE								8192
+#define TX_DESCRIPTOR_COUNT							256
+#define TX_BATCH_MAX_SIZE							512
+#define LOG_RESERVE_SIZE							1024
+
+/* The slot pool of the baseline */
+#define SLOT_COUNT									8
+#define SLOT_SIZE									1024
+
+#define MAX_PRODUCERS								16
+#define MESSAGE_MIN_SIZE							24
+#define MESSAGE_MAX_SIZE							120
+
+/* Message layout: size (2), producer (1), sequence (4), pattern */
+#define MESSAGE_HEADER_SIZE							7
+
+static unsigned int failures;
+
+#define CHECK(expr)	do { \
+		if (!(expr)) { \
+			printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #expr); \
+			failures++; \
+		} \
+	} while (0)
+
+typedef struct {
+	unsigned int producers;
+	unsigned int bursts;
+	unsigned int burst_length;
+	unsigned int pause_us;
+	unsigned int ns_per_byte;
+	unsigned int ns_per_transfer;
+} test_config_t;
+
+typedef struct {
+	double messages_per_second;
+	double blocked_total_ms;
+	double blocked_max_us;
+	unsigned long transfers;
+	unsigned long errors;
+} test_result_t;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static void busy_wait_until(uint64_t deadline)
+{
+	while (now_ns() < deadline) {
+	}
+}
+
+static uint32_t xorshift(uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+static uint8_t pattern(uint8_t producer, uint32_t seq, uint16_t i)
+{
+	return (uint8_t)((producer * 31U) + (seq * 7U) + i);
+}
+
+static void message_write(uint8_t *p, uint16_t size, uint8_t producer, uint32_t seq)
+{
+	memcpy(&p[0], &size, 2);
+	p[2] = producer;
+	memcpy(&p[3], &seq, 4);
+	for (uint16_t i = MESSAGE_HEADER_SIZE; i < size; i++) {
+		p[i] = pattern(producer, seq, i);
+	}
+}
+
+/**
+  * @brief  Checks the messages of one transfer
+  * @retval number of bytes that did not belong to a valid message
+  */
+static unsigned long messages_check(const uint8_t *p, uint32_t size, uint32_t *next_seq, unsigned long *count)
+{
+	unsigned long errors = 0;
+	uint32_t pos = 0;
+
+	while (pos + MESSAGE_HEADER_SIZE <= size) {
+		uint16_t len;
+		uint32_t seq;
+		memcpy(&len, &p[pos], 2);
+		const uint8_t producer = p[pos + 2];
+		memcpy(&seq, &p[pos + 3], 4);
+
+		if ((len < MESSAGE_HEADER_SIZE) || (pos + len > size) || (producer >= MAX_PRODUCERS) || (seq != next_seq[producer])) {
+			return errors + (size - pos);
+		}
+		for (uint16_t i = MESSAGE_HEADER_SIZE; i < len; i++) {
+			if (p[pos + i] != pattern(producer, seq, i)) {
+				errors++;
+			}
+		}
+		next_seq[producer]++;
+		(*count)++;
+		pos += len;
+	}
+
+	return errors + (size - pos);
+}
+
+/* ------------------------------------------------------------------------ */
+/* Unit tests                                                               */
+/* ------------------------------------------------------------------------ */
+
+static void test_units(void)
+{
+	static uint8_t buffer[256];
+	static ring_buffer_desc_t desc[4];
+	ring_buffer_t rb;
+	uint16_t h1, h2, h3, size, count;
+	uint8_t *p;
+
+	/* Unused part of the last reservation is given back */
+	ring_buffer_init(&rb, buffer, sizeof(buffer), desc, 4);
+	p = ring_buffer_reserve(&rb, 100, &h1);
+	CHECK(p == &buffer[0]);
+	ring_buffer_commit(&rb, h1, 40);
+	p = ring_buffer_reserve(&rb, 10, &h2);
+	CHECK(p == &buffer[40]);
+	ring_buffer_commit(&rb, h2, 10);
+	p = ring_buffer_read(&rb, 512, &size, &count);
+	CHECK((p == &buffer[0]) && (50 == size) && (2 == count));
+	ring_buffer_release(&rb, rb.desc_read);
+
+	/* Not given back when another reservation follows, read stops at the gap */
+	ring_buffer_init(&rb, buffer, sizeof(buffer), desc, 4);
+	ring_buffer_reserve(&rb, 100, &h1);
+	p = ring_buffer_reserve(&rb, 100, &h2);
+	CHECK(p == &buffer[100]);
+	ring_buffer_commit(&rb, h1, 40);
+	p = ring_buffer_read(&rb, 512, &size, &count);
+	CHECK((p == &buffer[0]) && (40 == size) && (1 == count));
+	CHECK(NULL == ring_buffer_read(&rb, 512, &size, &count));
+	ring_buffer_commit(&rb, h2, 100);
+	p = ring_buffer_read(&rb, 512, &size, &count);
+	CHECK((p == &buffer[100]) && (100 == size) && (1 == count));
+	ring_buffer_release(&rb, rb.desc_read);
+
+	/* A region does not wrap, the end of the buffer is skipped */
+	ring_buffer_init(&rb, buffer, sizeof(buffer), desc, 4);
+	ring_buffer_reserve(&rb, 200, &h1);
+	ring_buffer_commit(&rb, h1, 200);
+	ring_buffer_read(&rb, 512, &size, &count);
+	ring_buffer_release(&rb, rb.desc_read);
+	p = ring_buffer_reserve(&rb, 100, &h1);
+	CHECK(p == &buffer[0]);
+	ring_buffer_commit(&rb, h1, 100);
+
+	/* Full: data */
+	ring_buffer_init(&rb, buffer, sizeof(buffer), desc, 4);
+	ring_buffer_reserve(&rb, 200, &h1);
+	CHECK(NULL == ring_buffer_reserve(&rb, 100, &h2));
+	CHECK(NULL != ring_buffer_reserve(&rb, 56, &h2));
+
+	/* Full: descriptors */
+	ring_buffer_init(&rb, buffer, sizeof(buffer), desc, 4);
+	for (int i = 0; i < 4; i++) {
+		CHECK(NULL != ring_buffer_reserve(&rb, 1, &h1));
+	}
+	CHECK(NULL == ring_buffer_reserve(&rb, 1, &h1));
+
+	/* Coalescing stops at max_size */
+	ring_buffer_init(&rb, buffer, sizeof(buffer), desc, 4);
+	ring_buffer_reserve(&rb, 60, &h1);
+	ring_buffer_reserve(&rb, 60, &h2);
+	ring_buffer_reserve(&rb, 60, &h3);
+	ring_buffer_commit(&rb, h1, 60);
+	ring_buffer_commit(&rb, h2, 60);
+	ring_buffer_commit(&rb, h3, 60);
+	p = ring_buffer_read(&rb, 150, &size, &count);
+	CHECK((p == &buffer[0]) && (120 == size) && (2 == count));
+	p = ring_buffer_read(&rb, 150, &size, &count);
+	CHECK((p == &buffer[120]) && (60 == size) && (1 == count));
+	ring_buffer_release(&rb, rb.desc_read);
+
+	/* Skipped records are not read */
+	ring_buffer_init(&rb, buffer, sizeof(buffer), desc, 4);
+	ring_buffer_reserve(&rb, 10, &h1);
+	ring_buffer_reserve(&rb, 10, &h2);
+	ring_buffer_commit(&rb, h1, 10);
+	ring_buffer_commit(&rb, h2, 10);
+	CHECK(1 == ring_buffer_skip(&rb, 1));
+	p = ring_buffer_read(&rb, 512, &size, &count);
+	CHECK((p == &buffer[10]) && (10 == size) && (1 == count));
+	ring_buffer_release(&rb, rb.desc_read);
+	CHECK(rb.desc_tail == 2);
+}
+
+/**
+  * @brief  Randomized single thread run: several open reservations committed
+  * 		in random order, reads with random limits, checked message by message
+  */
+static void test_random(void)
+{
+	static uint8_t buffer[TX_BUFFER_SIZE];
+	static ring_buffer_desc_t desc[TX_DESCRIPTOR_COUNT];
+	ring_buffer_t rb;
+	struct { uint8_t *p; uint16_t handle; uint16_t size; uint32_t seq; } open[8];
+	unsigned int open_count = 0;
+	uint32_t next_seq[MAX_PRODUCERS] = { 0 };
+	uint32_t seq = 0;
+	uint32_t rng = 12345;
+	unsigned long errors = 0;
+	unsigned long count = 0;
+
+	ring_buffer_init(&rb, buffer, sizeof(buffer), desc, TX_DESCRIPTOR_COUNT);
+
+	for (int step = 0; step < 2000000; step++) {
+		const uint32_t op = xorshift(&rng) % 4;
+
+		if ((0 == op) && (open_count < 8)) {
+			uint16_t handle;
+			uint8_t *p = ring_buffer_reserve(&rb, LOG_RESERVE_SIZE, &handle);
+			if (NULL != p) {
+				open[open_count].p      = p;
+				open[open_count].handle = handle;
+				open[open_count].size   = (uint16_t)(MESSAGE_MIN_SIZE + (xorshift(&rng) % (MESSAGE_MAX_SIZE - MESSAGE_MIN_SIZE)));
+				open[open_count].seq    = 0;
+				open_count++;
+			}
+		} else if ((1 == op) && (0 != open_count)) {
+			/* Messages are numbered in commit order, the ring keeps reservation order,
+			so only the oldest open reservation gets the next number */
+			const unsigned int i = 0;
+			open[i].seq = seq++;
+			message_write(open[i].p, open[i].size, 0, open[i].seq);
+			ring_buffer_commit(&rb, open[i].handle, open[i].size);
+			memmove(&open[0], &open[1], (open_count - 1) * sizeof(open[0]));
+			open_count--;
+		} else if (2 == op) {
+			uint16_t size, n;
+			const uint8_t *p = ring_buffer_read(&rb, (uint16_t)(64 + (xorshift(&rng) % 1024)), &size, &n);
+			if (NULL != p) {
+				unsigned long before = count;
+				errors += messages_check(p, size, next_seq, &count);
+				if (count - before != n) {
+					errors++;
+				}
+				ring_buffer_release(&rb, rb.desc_read);
+			}
+		}
+	}
+
+	CHECK(0 == errors);
+	CHECK(count > 100000);
+}
+
+/* ------------------------------------------------------------------------ */
+/* Throughput                                                               */
+/* ------------------------------------------------------------------------ */
+
+typedef struct {
+	uint8_t *pbuf;
+	uint16_t size;
+} slot_t;
+
+/* Minimal blocking FIFO, stands in for a FreeRTOS queue */
+typedef struct {
+	pthread_mutex_t lock;
+	pthread_cond_t  cond;
+	slot_t          items[SLOT_COUNT];
+	unsigned int    head;
+	unsigned int    count;
+} fifo_t;
+
+static void fifo_init(fifo_t *q)
+{
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->cond, NULL);
+	q->head  = 0;
+	q->count = 0;
+}
+
+static void fifo_put(fifo_t *q, slot_t item)
+{
+	pthread_mutex_lock(&q->lock);
+	q->items[(q->head + q->count) % SLOT_COUNT] = item;
+	q->count++;
+	pthread_cond_signal(&q->cond);
+	pthread_mutex_unlock(&q->lock);
+}
+
+/* returns the time spent blocked in ns */
+static uint64_t fifo_get(fifo_t *q, slot_t *item)
+{
+	uint64_t blocked = 0;
+
+	pthread_mutex_lock(&q->lock);
+	if (0 == q->count) {
+		const uint64_t start = now_ns();
+		while (0 == q->count) {
+			pthread_cond_wait(&q->cond, &q->lock);
+		}
+		blocked = now_ns() - start;
+	}
+	*item   = q->items[q->head];
+	q->head = (q->head + 1) % SLOT_COUNT;
+	q->count--;
+	pthread_mutex_unlock(&q->lock);
+
+	return blocked;
+}
+
+typedef struct {
+	const test_config_t *config;
+	uint8_t              id;
+	uint64_t             blocked_total;
+	uint64_t             blocked_max;
+} producer_t;
+
+static struct {
+	uint8_t            buffer[TX_BUFFER_SIZE];
+	ring_buffer_desc_t desc[TX_DESCRIPTOR_COUNT];
+	ring_buffer_t      rb;
+	pthread_mutex_t    lock;
+	pthread_cond_t     space_available;
+	pthread_cond_t     data_available;
+} ring;
+
+static struct {
+	uint8_t buffer[SLOT_COUNT * SLOT_SIZE];
+	fifo_t  available;
+	fifo_t  ready;
+} pool;
+
+static void transmit(const test_config_t *config, uint32_t size)
+{
+	busy_wait_until(now_ns() + config->ns_per_transfer + ((uint64_t)size * config->ns_per_byte));
+}
+
+static void blocked_add(producer_t *producer, uint64_t blocked)
+{
+	producer->blocked_total += blocked;
+	if (blocked > producer->blocked_max) {
+		producer->blocked_max = blocked;
+	}
+}
+
+static void *ring_producer(void *arg)
+{
+	producer_t *producer = arg;
+	const test_config_t *config = producer->config;
+	uint32_t rng = 0x9E3779B9U * (producer->id + 1U);
+	uint32_t seq = 0;
+
+	for (unsigned int burst = 0; burst < config->bursts; burst++) {
+		for (unsigned int i = 0; i < config->burst_length; i++) {
+			const uint16_t size = (uint16_t)(MESSAGE_MIN_SIZE + (xorshift(&rng) % (MESSAGE_MAX_SIZE - MESSAGE_MIN_SIZE)));
+			uint16_t handle;
+
+			/* Same pattern as uart_ring_reserve: retry under the lock the consumer signals with */
+			uint8_t *p = ring_buffer_reserve(&ring.rb, LOG_RESERVE_SIZE, &handle);
+			if (NULL == p) {
+				const uint64_t start = now_ns();
+				pthread_mutex_lock(&ring.lock);
+				while (NULL == (p = ring_buffer_reserve(&ring.rb, LOG_RESERVE_SIZE, &handle))) {
+					pthread_cond_wait(&ring.space_available, &ring.lock);
+				}
+				pthread_mutex_unlock(&ring.lock);
+				blocked_add(producer, now_ns() - start);
+			}
+
+			message_write(p, size, producer->id, seq++);
+			ring_buffer_commit(&ring.rb, handle, size);
+
+			pthread_mutex_lock(&ring.lock);
+			pthread_cond_signal(&ring.data_available);
+			pthread_mutex_unlock(&ring.lock);
+		}
+		busy_wait_until(now_ns() + (uint64_t)config->pause_us * 1000U);
+	}
+
+	return NULL;
+}
+
+static void *pool_producer(void *arg)
+{
+	producer_t *producer = arg;
+	const test_config_t *config = producer->config;
+	uint32_t rng = 0x9E3779B9U * (producer->id + 1U);
+	uint32_t seq = 0;
+
+	for (unsigned int burst = 0; burst < config->bursts; burst++) {
+		for (unsigned int i = 0; i < config->burst_length; i++) {
+			const uint16_t size = (uint16_t)(MESSAGE_MIN_SIZE + (xorshift(&rng) % (MESSAGE_MAX_SIZE - MESSAGE_MIN_SIZE)));
+			slot_t slot;
+
+			blocked_add(producer, fifo_get(&pool.available, &slot));
+			message_write(slot.pbuf, size, producer->id, seq++);
+			slot.size = size;
+			fifo_put(&pool.ready, slot);
+		}
+		busy_wait_until(now_ns() + (uint64_t)config->pause_us * 1000U);
+	}
+
+	return NULL;
+}
+
+static void run(const test_config_t *config, bool use_ring, test_result_t *result)
+{
+	pthread_t threads[MAX_PRODUCERS];
+	producer_t producers[MAX_PRODUCERS];
+	uint32_t next_seq[MAX_PRODUCERS] = { 0 };
+	const unsigned long total = (unsigned long)config->producers * config->bursts * config->burst_length;
+	unsigned long count = 0;
+	unsigned long errors = 0;
+	unsigned long transfers = 0;
+
+	if (use_ring) {
+		ring_buffer_init(&ring.rb, ring.buffer, TX_BUFFER_SIZE, ring.desc, TX_DESCRIPTOR_COUNT);
+		pthread_mutex_init(&ring.lock, NULL);
+		pthread_cond_init(&ring.space_available, NULL);
+		pthread_cond_init(&ring.data_available, NULL);
+	} else {
+		fifo_init(&pool.available);
+		fifo_init(&pool.ready);
+		for (unsigned int i = 0; i < SLOT_COUNT; i++) {
+			fifo_put(&pool.available, (slot_t){ &pool.buffer[i * SLOT_SIZE], 0 });
+		}
+	}
+
+	const uint64_t start = now_ns();
+
+	for (unsigned int i = 0; i < config->producers; i++) {
+		producers[i] = (producer_t){ config, (uint8_t)i, 0, 0 };
+		pthread_create(&threads[i], NULL, use_ring ? ring_producer : pool_producer, &producers[i]);
+	}
+
+	/* Consumer: the UART writer task and the DMA */
+	while (count < total) {
+		if (use_ring) {
+			uint16_t size, n;
+			const uint8_t *p = ring_buffer_read(&ring.rb, TX_BATCH_MAX_SIZE, &size, &n);
+			if (NULL == p) {
+				pthread_mutex_lock(&ring.lock);
+				if (NULL == (p = ring_buffer_read(&ring.rb, TX_BATCH_MAX_SIZE, &size, &n))) {
+					struct timespec ts;
+					clock_gettime(CLOCK_REALTIME, &ts);
+					ts.tv_nsec += 1000000;
+					if (ts.tv_nsec >= 1000000000) {
+						ts.tv_sec++;
+						ts.tv_nsec -= 1000000000;
+					}
+					pthread_cond_timedwait(&ring.data_available, &ring.lock, &ts);
+				}
+				pthread_mutex_unlock(&ring.lock);
+				if (NULL == p) {
+					continue;
+				}
+			}
+			transmit(config, size);
+			errors += messages_check(p, size, next_seq, &count);
+			transfers++;
+
+			pthread_mutex_lock(&ring.lock);
+			ring_buffer_release(&ring.rb, ring.rb.desc_read);
+			pthread_cond_broadcast(&ring.space_available);
+			pthread_mutex_unlock(&ring.lock);
+		} else {
+			slot_t slot;
+			fifo_get(&pool.ready, &slot);
+			transmit(config, slot.size);
+			errors += messages_check(slot.pbuf, slot.size, next_seq, &count);
+			transfers++;
+			fifo_put(&pool.available, slot);
+		}
+	}
+
+	const uint64_t elapsed = now_ns() - start;
+
+	uint64_t blocked_total = 0;
+	uint64_t blocked_max = 0;
+	for (unsigned int i = 0; i < config->producers; i++) {
+		pthread_join(threads[i], NULL);
+		blocked_total += producers[i].blocked_total;
+		if (producers[i].blocked_max > blocked_max) {
+			blocked_max = producers[i].blocked_max;
+		}
+	}
+
+	result->messages_per_second = (double)count * 1e9 / (double)elapsed;
+	result->blocked_total_ms    = (double)blocked_total / 1e6;
+	result->blocked_max_us      = (double)blocked_max / 1e3;
+	result->transfers           = transfers;
+	result->errors              = errors;
+}
+
+static void print_result(const char *name, const test_result_t *result)
+{
+	printf("%-12s %12.0f %12lu %18.1f %16.1f %8lu\n", name, result->messages_per_second, result->transfers,
+			result->blocked_total_ms, result->blocked_max_us, result->errors);
+}
+
+int main(int argc, char *argv[])
+{
+	test_config_t config = {
+		.producers       = 4,
+		.bursts          = 2000,
+		.burst_length    = 16,
+		.pause_us        = 200,
+		.ns_per_byte     = 20,
+		.ns_per_transfer = 2000,
+	};
+	unsigned int *fields[] = { &config.producers, &config.bursts, &config.burst_length, &config.pause_us, &config.ns_per_byte, &config.ns_per_transfer };
+
+	for (int i = 1; (i < argc) && (i <= 6); i++) {
+		*fields[i - 1] = (unsigned int)strtoul(argv[i], NULL, 0);
+	}
+	if ((0 == config.producers) || (config.producers > MAX_PRODUCERS)) {
+		fprintf(stderr, "producers must be 1..%d\n", MAX_PRODUCERS);
+		return 2;
+	}
+
+	test_units();
+	test_random();
+	printf("unit tests: %s\n", (0 == failures) ? "passed" : "FAILED");
+
+	test_result_t pool_result;
+	test_result_t ring_result;
+	run(&config, false, &pool_result);
+	run(&config, true, &ring_result);
+
+	printf("\n%u producers x %u bursts x %u messages (%d..%d bytes), %u us pause,\n"
+			"link %u ns/byte + %u ns/transfer\n\n",
+			config.producers, config.bursts, config.burst_length, MESSAGE_MIN_SIZE, MESSAGE_MAX_SIZE - 1,
+			config.pause_us, config.ns_per_byte, config.ns_per_transfer);
+	printf("%-12s %12s %12s %18s %16s %8s\n", "", "messages/s", "transfers", "blocked total [ms]", "blocked max [us]", "errors");
+	print_result("slot pool", &pool_result);
+	print_result("ring buffer", &ring_result);
+
+	if ((0 != pool_result.errors) || (0 != ring_result.errors)) {
+		failures++;
+	}
+
+	return (0 == failures) ? 0 : 1;
+}
@@ -0,0 +1,42 @@
+/*
+ * stm32f4xx_hal.h
+ *
+ *  Host stand-in for the few HAL/CMSIS definitions ring_buffer.c uses.
+ *  LDREX/STREX are emulated with a compare-and-swap of the value seen by
+ *  the last __LDREXW of the calling thread.
+ */
+
+#ifndef RING_BUFFER_TEST_STM32F4XX_HAL_H_
+#define RING_BUFFER_TEST_STM32F4XX_HAL_H_
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define assert_param(expr)							assert(expr)
+
+static _Thread_local uint32_t ldrex_value;
+
+static inline uint32_t __LDREXW(volatile uint32_t *addr)
+{
+	ldrex_value = __atomic_load_n(addr, __ATOMIC_ACQUIRE);
+	return ldrex_value;
+}
+
+static inline uint32_t __STREXW(uint32_t value, volatile uint32_t *addr)
+{
+	uint32_t expected = ldrex_value;
+	return __atomic_compare_exchange_n(addr, &expected, value, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST) ? 0U : 1U;
+}
+
+static inline void __CLREX(void)
+{
+}
+
+static inline void __DMB(void)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+#endif /* RING_BUFFER_TEST_STM32F4XX_HAL_H_ */